@@ -0,0 +1,99 @@
+#include "analysis.hpp"
+
+analysis::analysis(event_callback onEvent, std::size_t hashMegabytes)
+    :   _engine(hashMegabytes), _onEvent(std::move(onEvent)), _thread([this]() { run(); }) {}
+
+analysis::~analysis() {
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _wake.notify_all();
+    _thread.join();
+}
+
+std::uint64_t analysis::start(const chess& board, const move_history& moves, const search_limits& limits,
+                              bool ponder) {
+    stop();
+    std::uint64_t number;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _board = board;
+        _moves = moves;
+        _limits = limits;
+        _limits.pondering = &_pondering;
+        _stopped = false;
+        _engine.prepare();
+        // Set before the search can see it, so that an early ‹ponderhit› is not lost.
+        _pondering = ponder;
+        number = ++_searches;
+        _pending = true;
+    }
+    _wake.notify_all();
+    return number;
+}
+
+void analysis::ponderhit() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pondering = false;
+    }
+    _wake.notify_all();
+}
+
+void analysis::stop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _pondering = false;
+    _stopped = true;
+    if (!_pending && !_busy) {
+        return;
+    }
+    // The flag stays raised until the next ‹start› prepares the engine, so it also ends a search
+    // that has not begun yet.
+    _engine.stop();
+    _wake.notify_all();
+    _wake.wait(lock, [this]() { return !_pending && !_busy; });
+}
+
+bool analysis::running() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _pending || _busy;
+}
+
+void analysis::run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _wake.wait(lock, [this]() { return _pending || _quit; });
+        if (_quit) {
+            return;
+        }
+        chess board = _board;
+        move_history moves = _moves;
+        search_limits limits = _limits;
+        std::uint64_t number = _searches;
+        _pending = false;
+        _busy = true;
+        lock.unlock();
+
+        analysis_event event;
+        event.search = number;
+        event.result = _engine.search(board, moves, limits, [&](const search_result& r) {
+            analysis_event progress;
+            progress.search = number;
+            progress.result = r;
+            _onEvent(progress);
+        });
+        event.type = analysis_event::kind::finished;
+
+        lock.lock();
+        // A pondering search that ran out of depth waits for the move to be played, an infinite one
+        // for ‹stop›.
+        _wake.wait(lock, [this, &limits]() { return !_pondering && (!limits.infinite || _stopped); });
+        lock.unlock();
+        _onEvent(event);
+        lock.lock();
+        _busy = false;
+        _wake.notify_all();
+    }
+}
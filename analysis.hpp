@@ -0,0 +1,91 @@
+#pragma once
+
+#include "search.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Progress of an ‹analysis›: one event for every finished iteration and a last one when the
+// search is over, carrying the final result.
+struct analysis_event {
+    enum class kind : std::uint8_t { iteration, finished };
+
+    kind type = kind::iteration;
+    // Counts the calls to ‹analysis::start›, tells the events of a search from those of the
+    // previous ones.
+    std::uint64_t search = 0;
+    search_result result;
+};
+
+/* Searches in the background: ‹start› hands a position to a thread of the
+ * analysis and returns at once, the progress comes to the callback from that
+ * thread. Each analysis has its own ‹engine›, with its own table, so any number of
+ * them can run side by side.
+ *
+ * A new ‹start› ends the search before it. ‹stop› returns within a millisecond or
+ * so, after the ‹finished› event of the search has been delivered. A search
+ * started to «ponder» keeps going without limits, and holds back its ‹finished›
+ * event even if it runs out of depth, until ‹ponderhit› or ‹stop›; after
+ * ‹ponderhit› the limits apply, the time counted from then on. A search with
+ * ‹search_limits::infinite› holds back its ‹finished› event until ‹stop›.
+ *
+ * The callback must not call ‹start› or ‹stop› of its own analysis. */
+class analysis {
+public:
+    using event_callback = std::function<void(const analysis_event&)>;
+
+private:
+    engine _engine;
+    event_callback _onEvent;
+    std::atomic<bool> _pondering {false};
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    // Guarded by ‹_mutex›.
+    chess _board;
+    move_history _moves;
+    search_limits _limits;
+    std::uint64_t _searches = 0;
+    bool _pending = false;
+    bool _busy = false;
+    // Set by ‹stop›, releases the result of a search with ‹search_limits::infinite›.
+    bool _stopped = false;
+    bool _quit = false;
+
+    std::thread _thread;
+
+    void run();
+
+public:
+    explicit analysis(event_callback onEvent, std::size_t hashMegabytes = 16);
+
+    analysis(const analysis&) = delete;
+
+    analysis& operator=(const analysis&) = delete;
+
+    ~analysis();
+
+    // Ends the running search, if any, and starts searching ‹board›, reached by ‹moves›. Returns
+    // the number of the search, as in its events.
+    std::uint64_t start(const chess& board, const move_history& moves, const search_limits& limits,
+                        bool ponder = false);
+
+    std::uint64_t start(const chess& board, const search_limits& limits, bool ponder = false) {
+        return start(board, move_history(), limits, ponder);
+    }
+
+    // The move pondered on was played: the limits of the search apply from now on.
+    void ponderhit();
+
+    // Ends the search and waits for its ‹finished› event, does nothing when idle.
+    void stop();
+
+    // Whether a search is running or waiting to be delivered.
+    bool running() const;
+
+    // Options of the searches. Changing them while a search runs is not safe.
+    engine& searcher() { return _engine; }
+};
@@ -0,0 +1,178 @@
+#include "archive.hpp"
+#include <bit>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(std::endian::native == std::endian::little, "the archive is read and written in place");
+static_assert(sizeof(archive_header) == 32, "the header has no padding");
+
+static const char initial_fen[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static std::uint16_t encodeMove(ply p) {
+    return static_cast<std::uint16_t>(p.from | p.to << 6 | static_cast<int>(p.promote) << 12);
+}
+
+static ply decodeMove(const std::uint8_t* bytes) {
+    int code = bytes[0] | bytes[1] << 8;
+    ply p;
+    p.from = code & 63;
+    p.to = code >> 6 & 63;
+    p.promote = static_cast<piece_type>(code >> 12 & 7);
+    return p;
+}
+
+bool archive_writer::open(const char* path) {
+    close();
+    _file = std::fopen(path, "wb");
+    if (!_file) {
+        return false;
+    }
+    _header = archive_header();
+    _header.indexOffset = sizeof(archive_header);
+    _offsets.clear();
+    // The header is written again with the counts by ‹close›.
+    return std::fwrite(&_header, sizeof(_header), 1, _file) == 1;
+}
+
+bool archive_writer::add(const game_record& record) {
+    chess board = record.start;
+    _buffer.clear();
+    _buffer.push_back(static_cast<std::uint8_t>(record.outcome));
+    char fen[chess::max_fen_length];
+    int length = board.toFEN(fen);
+    if (std::string_view(fen, length) != initial_fen) {
+        _buffer[0] |= has_fen;
+        _buffer.push_back(static_cast<std::uint8_t>(length));
+        _buffer.insert(_buffer.end(), fen, fen + length);
+    }
+    for (ply p: record.moves) {
+        if (!board.isPromote(p.origin(), p.target())) {
+            p.promote = piece_type::pawn;
+        }
+        result r = board.play(p.origin(), p.target(), p.promote);
+        if (r != result::ok && r != result::capture) {
+            return false;
+        }
+        std::uint16_t code = encodeMove(p);
+        _buffer.push_back(static_cast<std::uint8_t>(code));
+        _buffer.push_back(static_cast<std::uint8_t>(code >> 8));
+    }
+    if (std::fwrite(_buffer.data(), 1, _buffer.size(), _file) != _buffer.size()) {
+        return false;
+    }
+    // Until ‹close› the index offset is where the next game goes.
+    _offsets.push_back(_header.indexOffset);
+    _header.indexOffset += _buffer.size();
+    ++_header.games;
+    _header.plies += record.moves.size();
+    return true;
+}
+
+bool archive_writer::close() {
+    if (!_file) {
+        return true;
+    }
+    _offsets.push_back(_header.indexOffset);
+    bool good = std::fwrite(_offsets.data(), sizeof(std::uint64_t), _offsets.size(), _file) == _offsets.size() &&
+                std::fseek(_file, 0, SEEK_SET) == 0 &&
+                std::fwrite(&_header, sizeof(_header), 1, _file) == 1;
+    good = std::fclose(_file) == 0 && good;
+    _file = nullptr;
+    _offsets.clear();
+    return good;
+}
+
+bool game_cursor::reset(const archive_game& game) {
+    _next = game.moves.data();
+    _end = game.moves.data() + game.moves.size();
+    if (game.fen.empty()) {
+        _board = chess();
+        return true;
+    }
+    return _board.fromFEN(game.fen);
+}
+
+bool game_cursor::advance(ply& out) {
+    if (_end - _next < 2) {
+        return false;
+    }
+    out = decodeMove(_next);
+    _next += 2;
+    if (out.promote > piece_type::king || !_board.isLegal(out)) {
+        _next = _end;
+        return false;
+    }
+    _board.makeMove(out);
+    return true;
+}
+
+std::uint64_t archive_reader::offset(std::uint64_t n) const {
+    std::uint64_t value;
+    std::memcpy(&value, _index + n * sizeof(value), sizeof(value));
+    return value;
+}
+
+bool archive_reader::open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= static_cast<off_t>(sizeof(archive_header))) {
+        data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    _data = static_cast<const std::uint8_t*>(data);
+    _size = info.st_size;
+    std::memcpy(&_header, _data, sizeof(_header));
+    archive_header expected;
+    if (std::memcmp(_header.magic, expected.magic, sizeof(expected.magic)) != 0 ||
+        _header.version != expected.version || _header.indexOffset > _size ||
+        (_size - _header.indexOffset) / sizeof(std::uint64_t) != _header.games + 1) {
+        close();
+        return false;
+    }
+    _index = _data + _header.indexOffset;
+    return true;
+}
+
+void archive_reader::close() {
+    if (_data) {
+        munmap(const_cast<std::uint8_t*>(_data), _size);
+    }
+    _data = nullptr;
+    _size = 0;
+    _index = nullptr;
+    _header = archive_header();
+}
+
+archive_game archive_reader::game(std::uint64_t n) const {
+    archive_game game;
+    std::uint64_t begin = offset(n);
+    std::uint64_t end = offset(n + 1);
+    // A damaged index gives an empty game rather than reading out of the file.
+    if (begin >= end || end > _header.indexOffset) {
+        return game;
+    }
+    const std::uint8_t* p = _data + begin;
+    std::uint8_t flags = *p++;
+    game.outcome = static_cast<game_outcome>(flags & 3);
+    if (flags & has_fen) {
+        std::uint8_t length = *p;
+        if (end - begin < 2u + length) {
+            return game;
+        }
+        game.fen = std::string_view(reinterpret_cast<const char*>(p + 1), length);
+        p += 1 + length;
+    }
+    game.moves = std::span<const std::uint8_t>(p, _data + end);
+    return game;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "chess.hpp"
+#include "pgn.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/* Compact binary game archive.
+ *
+ * ├┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┼┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┤
+ * │ ‹archive_header›   │ magic, version, number of games and plies, │
+ * │                    │ offset of the index                        │
+ * │ games              │ one record after another                   │
+ * │ index              │ offset of every game and of the index      │
+ *
+ * A game record is one byte of flags (the ‹game_outcome› in the low two bits and
+ * ‹has_fen›), the start position as a length byte and a FEN if ‹has_fen› is set,
+ * and then two bytes per ply: the square indices of the origin and the target in
+ * the low twelve bits and the ‹piece_type› promoted to above them, so the moves
+ * do not depend on the order of any move generator. The number of plies follows
+ * from the offsets. All numbers are little endian. A version 1 archive, which
+ * stored the index of the move among the legal ones, is not read. */
+
+struct archive_header {
+    char magic[4] = {'C', 'G', 'A', 'R'};
+    std::uint32_t version = 2;
+    std::uint64_t games = 0;
+    std::uint64_t plies = 0;
+    std::uint64_t indexOffset = 0;
+};
+
+constexpr std::uint8_t has_fen = 4;
+
+// Appends games to a new archive file. The offsets of the games stay in memory until ‹close›.
+class archive_writer {
+    std::FILE* _file = nullptr;
+    archive_header _header;
+    std::vector<std::uint64_t> _offsets;
+    std::vector<std::uint8_t> _buffer;
+
+public:
+    archive_writer() = default;
+
+    archive_writer(const archive_writer&) = delete;
+
+    archive_writer& operator=(const archive_writer&) = delete;
+
+    ~archive_writer() { close(); }
+
+    bool open(const char* path);
+
+    // Plays the moves of the record from its start with ‹chess::play› and stores the game.
+    // Returns false without storing anything if one of the moves is illegal.
+    bool add(const game_record& record);
+
+    // Writes the index and the header. Returns false if any write failed.
+    bool close();
+};
+
+// One game of an archive, pointing into the mapped file.
+struct archive_game {
+    game_outcome outcome = game_outcome::unknown;
+    // Empty for the initial position.
+    std::string_view fen;
+    // Two bytes per ply, see ‹archive_header›.
+    std::span<const std::uint8_t> moves;
+
+    std::size_t plies() const { return moves.size() / 2; }
+};
+
+// Replays a game of an archive one ply at a time.
+class game_cursor {
+    chess _board;
+    const std::uint8_t* _next = nullptr;
+    const std::uint8_t* _end = nullptr;
+
+public:
+    // Returns false if the start position of the game is invalid.
+    bool reset(const archive_game& game);
+
+    // Position before the next ply.
+    const chess& board() const { return _board; }
+
+    // Makes the next ply and stores it into ‹out›. Returns false at the end of the game or when the
+    // stored move is not legal.
+    bool advance(ply& out);
+};
+
+// Read-only view of an archive file mapped into memory, nothing is copied.
+class archive_reader {
+    const std::uint8_t* _data = nullptr;
+    std::size_t _size = 0;
+    archive_header _header;
+    const std::uint8_t* _index = nullptr;
+
+    std::uint64_t offset(std::uint64_t n) const;
+
+public:
+    archive_reader() = default;
+
+    archive_reader(const archive_reader&) = delete;
+
+    archive_reader& operator=(const archive_reader&) = delete;
+
+    ~archive_reader() { close(); }
+
+    // Maps the file, returns false if it cannot be mapped or is not a valid archive.
+    bool open(const char* path);
+
+    void close();
+
+    std::uint64_t size() const { return _header.games; }
+
+    std::uint64_t plies() const { return _header.plies; }
+
+    // Game ‹n›, counted from zero, has to be less than ‹size›.
+    archive_game game(std::uint64_t n) const;
+};
@@ -0,0 +1,161 @@
+/* Bench: measures the speed of the rules.
+ *
+ *   bench [-r repetitions] [-g games]
+ *
+ * Every benchmark runs once to warm up and then ‹-r› times (5 by default), and
+ * prints the fastest and the median time per operation:
+ *
+ * ├┄┄┄┄┄┄┄┄┄┄┼┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┤
+ * │ play     │ ‹chess::play› of every move of the games, from the initial      │
+ * │          │ position                                                        │
+ * │ checked  │ ‹chess::isChecked› on every position of the games               │
+ * │ copy     │ copying the board of every position                             │
+ * │ generate │ ‹chess::generateLegalMoves› on every position                   │
+ * │ classify │ ‹chess::classifyMoves› on every position                        │
+ *
+ * The games are the «Opera game» and ‹-g› games (8 by default) of random legal
+ * moves from a fixed seed, so the numbers of two builds can be compared. */
+
+#include "chess.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+static const char* opera_game[] = {
+    "e2e4", "e7e5", "g1f3", "d7d6", "d2d4", "c8g4", "d4e5", "g4f3", "d1f3", "d6e5", "f1c4",
+    "g8f6", "f3b3", "d8e7", "b1c3", "c7c6", "c1g5", "b7b5", "c3b5", "c6b5", "c4b5", "b8d7",
+    "e1c1", "a8d8", "d1d7", "d8d7", "h1d1", "e7e6", "b5d7", "f6d7", "b3b8", "d7b8", "d1d8"};
+
+constexpr int random_game_plies = 200;
+
+// Keeps the compiler from dropping a computation whose result is not used.
+template <typename T>
+static void keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+static std::uint64_t nextRandom(std::uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static std::vector<std::vector<ply>> scriptGames(int randomGames) {
+    std::vector<std::vector<ply>> games(1);
+    for (const char* text: opera_game) {
+        ply p;
+        ply::fromString(text, p);
+        games[0].push_back(p);
+    }
+    std::uint64_t state = 0x9e3779b97f4a7c15;
+    for (int n = 0; n < randomGames; ++n) {
+        chess board;
+        std::vector<ply> game;
+        ply_list moves;
+        for (int i = 0; i < random_game_plies; ++i) {
+            board.generateLegalMoves(moves);
+            if (moves.size == 0) {
+                break;
+            }
+            ply p = moves.moves[nextRandom(state) % moves.size];
+            board.makeMove(p);
+            game.push_back(p);
+        }
+        games.push_back(game);
+    }
+    return games;
+}
+
+// Runs ‹body›, which does ‹operations› of something, and prints the time of one.
+static void measure(const char* name, int repetitions, std::uint64_t operations, const std::function<void()>& body) {
+    body();
+    std::vector<double> times;
+    for (int i = 0; i < repetitions; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        times.push_back(elapsed.count() / operations);
+    }
+    std::sort(times.begin(), times.end());
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << times.front() << " ns/op  median " << std::setw(10) << times[times.size() / 2]
+              << " ns/op  " << operations << " ops\n";
+}
+
+static int usage() {
+    std::cerr << "usage: bench [-r repetitions] [-g games]\n";
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    int repetitions = 5;
+    int randomGames = 8;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            repetitions = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            randomGames = std::max(0, std::atoi(argv[++i]));
+        } else {
+            return usage();
+        }
+    }
+    std::vector<std::vector<ply>> games = scriptGames(randomGames);
+    std::vector<chess> positions;
+    for (const std::vector<ply>& game: games) {
+        chess board;
+        for (ply p: game) {
+            positions.push_back(board);
+            if (board.play(p.origin(), p.target(), p.promote) > result::ok) {
+                std::cerr << "bad scripted move " << p.toString() << '\n';
+                return 1;
+            }
+        }
+        positions.push_back(board);
+    }
+    std::uint64_t plies = positions.size() - games.size();
+    std::cout << games.size() << " games, " << positions.size() << " positions, board of " << sizeof(chess)
+              << " bytes\n";
+
+    measure("play", repetitions, plies, [&]() {
+        for (const std::vector<ply>& game: games) {
+            chess board;
+            for (ply p: game) {
+                keep(board.play(p.origin(), p.target(), p.promote));
+            }
+        }
+    });
+    measure("checked", repetitions, positions.size(), [&]() {
+        for (chess& board: positions) {
+            keep(board.isChecked());
+        }
+    });
+    chess copy;
+    measure("copy", repetitions, positions.size(), [&]() {
+        for (const chess& board: positions) {
+            copy = board;
+            keep(copy);
+        }
+    });
+    ply_list moves;
+    measure("generate", repetitions, positions.size(), [&]() {
+        for (chess& board: positions) {
+            board.generateLegalMoves(moves);
+            keep(moves.size);
+        }
+    });
+    move_table table;
+    measure("classify", repetitions, positions.size(), [&]() {
+        for (chess& board: positions) {
+            board.classifyMoves(table);
+            keep(table);
+        }
+    });
+    return 0;
+}
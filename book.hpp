@@ -0,0 +1,86 @@
+#pragma once
+
+#include "chess.hpp"
+#include <cstdint>
+#include <vector>
+
+/* Opening book in the layout of the Polyglot books: a file of 16 byte entries
+ * sorted by key, no header, all numbers big endian.
+ *
+ * ├┄┄┄┄┄┄┄┄┄┄┼┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┤
+ * │ key      │ 64 bit key of the position                                 │
+ * │ move     │ 16 bits: target file and rank, origin file and rank, three │
+ * │          │ bits each from the lowest, and the promotion (0 none,      │
+ * │          │ 1 knight, 2 bishop, 3 rook, 4 queen); castling is written  │
+ * │          │ as the king taking its own rook                            │
+ * │ weight   │ 16 bits, the moves are picked in proportion to it          │
+ * │ learn    │ 32 bits, unused                                            │
+ *
+ * The key is ‹polyglotKey›, so books made by other programs can be probed and
+ * the books written by ‹book_builder› can be read by them. */
+
+constexpr std::size_t book_entry_size = 16;
+
+// Polyglot key of the position: its pieces, castling rights, player to move and the file of an
+// «en passant» target if a pawn of the player to move stands next to the pawn that can be taken.
+std::uint64_t polyglotKey(const chess& board);
+
+struct book_move {
+    ply move;
+    std::uint16_t weight = 0;
+};
+
+// Collects the moves played from positions and writes them as a book.
+class book_builder {
+    struct entry {
+        std::uint64_t key;
+        std::uint16_t move;
+        std::uint32_t weight;
+    };
+
+    std::vector<entry> _entries;
+
+public:
+    // Adds ‹weight› to the move ‹p›, which has to be legal on ‹board›.
+    void add(const chess& board, ply p, std::uint32_t weight);
+
+    // Writes the book: the weights of a move are summed up and capped at 65535, and the moves of
+    // a position come with the highest weight first. Returns false if the file cannot be written.
+    bool write(const char* path);
+};
+
+/* Read-only view of a book file mapped into memory. The pages are shared by all
+ * processes that open the same book and nothing is read until a position is
+ * looked up, which takes a binary search over the entries. */
+class opening_book {
+    const std::uint8_t* _data = nullptr;
+    std::size_t _size = 0;
+
+    std::uint64_t keyAt(std::size_t n) const;
+
+public:
+    opening_book() = default;
+
+    opening_book(const opening_book&) = delete;
+
+    opening_book& operator=(const opening_book&) = delete;
+
+    ~opening_book() { close(); }
+
+    // Maps the file, returns false if it cannot be mapped or its size is not a multiple of
+    // ‹book_entry_size›.
+    bool open(const char* path);
+
+    void close();
+
+    // Number of entries.
+    std::size_t size() const { return _size / book_entry_size; }
+
+    // Legal moves of the book for the position, the highest weight first. Entries that do not
+    // decode to a legal move are left out.
+    std::vector<book_move> probe(chess& board) const;
+
+    // Chooses a move of ‹probe› in proportion to the weights, ‹random› being any random number.
+    // Returns false if the book has no move with a weight for the position.
+    bool pick(chess& board, std::uint64_t random, ply& out) const;
+};
@@ -1,52 +1,274 @@
 #include "chess.hpp"
-#include <cassert>
-
-bool move::isDiagonal() { return (std::abs(file) == std::abs(rank)); }
-
-bool move::isStraight() { return (file == 0 || rank == 0); }
+#include "eval.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <type_traits>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+static_assert(std::is_trivially_copyable_v<chess>, "copying a board has to stay a plain memcpy");
+
+static constexpr int index(piece_type piece) { return static_cast<int>(piece); }
+
+static constexpr int index(player player) { return static_cast<int>(player); }
+
+// Squares attacked by a rook (‹diagonal› false) or a bishop on ‹square›. Every ray ends
+// with the first occupied square. Slow, only used to fill the lookup tables.
+static constexpr bitboard slidingAttacks(int square, bitboard occupied, bool diagonal) {
+    constexpr move straight[4] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    constexpr move diagonals[4] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    bitboard set = 0;
+    for (move dir: diagonal ? diagonals : straight) {
+        for (position to = position::fromIndex(square) + dir; to != position(); to = to + dir) {
+            set |= squareBit(to.index());
+            if (occupied & squareBit(to.index())) {
+                break;
+            }
+        }
+    }
+    return set;
+}
 
-void move::directionize() {
-    if (file != 0) {
-        file = file / std::abs(file);
+// Fixed relations of the squares, computed at compile time.
+struct geometry_tables {
+    // Squares attacked from every square by a knight, a king and a pawn of either player.
+    bitboard knight[64] {};
+    bitboard king[64] {};
+    bitboard pawn[2][64] {};
+    // Squares strictly between two squares on a common rank, file or diagonal, empty otherwise.
+    bitboard between[64][64] {};
+    // The whole rank, file or diagonal through two squares including both, empty if there is none.
+    bitboard line[64][64] {};
+};
+
+static constexpr geometry_tables makeGeometry() {
+    geometry_tables t;
+    for (int square = 0; square < 64; ++square) {
+        position from = position::fromIndex(square);
+        auto add = [&](bitboard& set, move m) {
+            position to = from + m;
+            if (to != position()) {
+                set |= squareBit(to.index());
+            }
+        };
+        for (move m: {move{1, 2}, move{2, 1}, move{2, -1}, move{1, -2},
+                      move{-1, -2}, move{-2, -1}, move{-2, 1}, move{-1, 2}}) {
+            add(t.knight[square], m);
+        }
+        for (move m: {move{1, 1}, move{1, 0}, move{1, -1}, move{0, -1},
+                      move{-1, -1}, move{-1, 0}, move{-1, 1}, move{0, 1}}) {
+            add(t.king[square], m);
+        }
+        add(t.pawn[index(player::white)][square], move{1, 1});
+        add(t.pawn[index(player::white)][square], move{-1, 1});
+        add(t.pawn[index(player::black)][square], move{1, -1});
+        add(t.pawn[index(player::black)][square], move{-1, -1});
     }
-    if (rank != 0) {
-        rank = rank / std::abs(rank);
+    for (int a = 0; a < 64; ++a) {
+        for (int b = 0; b < 64; ++b) {
+            move dir = position::fromIndex(b) - position::fromIndex(a);
+            if (a == b || (!dir.isStraight() && !dir.isDiagonal())) {
+                continue;
+            }
+            dir.directionize();
+            move back = {-dir.file, -dir.rank};
+            for (position p = position::fromIndex(a) + dir; p.index() != b; p = p + dir) {
+                t.between[a][b] |= squareBit(p.index());
+            }
+            t.line[a][b] = squareBit(a);
+            for (move m: {dir, back}) {
+                for (position p = position::fromIndex(a) + m; p != position(); p = p + m) {
+                    t.line[a][b] |= squareBit(p.index());
+                }
+            }
+        }
     }
+    return t;
 }
 
-bool move::operator==(move other) { return (rank == other.rank && file == other.file); }
-
-bool move::operator!=(move other) { return !(*this == other); }
+/* Lookup of the squares attacked by a rook or a bishop. Only the squares of its rays
+ * without the last one can block the piece, so these «relevant» squares of the
+ * occupancy are mapped to an index into a table of precomputed attack sets: with
+ * the PEXT instruction where available and otherwise by a «magic» multiplication
+ * that moves the relevant bits to the top without destructive collisions. */
+struct slider {
+    bitboard mask = 0;
+    bitboard magic = 0;
+    int shift = 0;
+    // Offset of the square's attack sets in the table of the piece.
+    int offset = 0;
+
+    int index(bitboard occupied) const {
+#ifdef __BMI2__
+        return offset + static_cast<int>(_pext_u64(occupied, mask));
+#else
+        return offset + static_cast<int>(((occupied & mask) * magic) >> shift);
+#endif
+    }
+};
 
-move move::vert(int offset) { return {0, offset}; }
+static constexpr geometry_tables geometry = makeGeometry();
 
-move move::horiz(int offset) { return {offset, 0}; }
+static_assert(geometry.between[0][63] == 0x0040201008040200, "a1-h8 passes b2 to g7");
+static_assert(geometry.line[0][9] == 0x8040201008040201 && geometry.line[0][17] == 0, "a1, b2 lie on the long diagonal");
 
-move move::abs(move m) { return {std::abs(m.file), std::abs(m.rank)}; }
+// Squares attacked by the sliding pieces, filled at startup.
+struct attack_tables {
+    slider rook[64] {};
+    slider bishop[64] {};
+    bitboard rookAttacks[102400] {};
+    bitboard bishopAttacks[5248] {};
 
-move position::operator-(position other) { return {file - other.file, rank - other.rank}; }
+    void initSliders(slider* sliders, bitboard* attacks, bool diagonal);
 
-position position::operator+(move other) {
-    position result = {file + other.file, rank + other.rank};
-    if (result.rank < 1 || result.rank > 8 || result.file < 1 || result.file > 8) {
-        return position();
+    attack_tables() {
+        initSliders(rook, rookAttacks, false);
+        initSliders(bishop, bishopAttacks, true);
+    }
+};
+
+void attack_tables::initSliders(slider* sliders, bitboard* attacks, bool diagonal) {
+    const bitboard rank1 = 0xff;
+    const bitboard rank8 = rank1 << 56;
+    const bitboard fileA = 0x0101010101010101;
+    const bitboard fileH = fileA << 7;
+    // The magics are searched for with fixed seeds, so the tables are the same on every run.
+    // Seeding the search of every square by its rank with known good values keeps it short.
+    static const std::uint64_t seeds[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+    std::uint64_t state = 0;
+    auto random = [&state]() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545f4914f6cdd1d;
+    };
+    bitboard occupancies[4096];
+    bitboard references[4096];
+    int epochs[4096] {};
+    int epoch = 0;
+    int offset = 0;
+    for (int square = 0; square < 64; ++square) {
+        slider& s = sliders[square];
+        state = seeds[square / 8];
+        bitboard edges = ((rank1 | rank8) & ~(rank1 << (square / 8 * 8))) |
+                         ((fileA | fileH) & ~(fileA << (square % 8)));
+        s.mask = slidingAttacks(square, 0, diagonal) & ~edges;
+        int bits = std::popcount(s.mask);
+        s.shift = 64 - bits;
+        s.offset = offset;
+        // Enumerates all subsets of the mask.
+        int size = 0;
+        bitboard occupied = 0;
+        do {
+            occupancies[size] = occupied;
+            references[size] = slidingAttacks(square, occupied, diagonal);
+            ++size;
+            occupied = (occupied - s.mask) & s.mask;
+        } while (occupied);
+        offset += size;
+#ifdef __BMI2__
+        for (int i = 0; i < size; ++i) {
+            attacks[s.index(occupancies[i])] = references[i];
+        }
+#else
+        bool found = false;
+        while (!found) {
+            s.magic = random() & random() & random();
+            if (std::popcount((s.mask * s.magic) >> 56) < 6) {
+                continue;
+            }
+            ++epoch;
+            found = true;
+            for (int i = 0; i < size && found; ++i) {
+                int at = s.index(occupancies[i]);
+                if (epochs[at - s.offset] != epoch) {
+                    epochs[at - s.offset] = epoch;
+                    attacks[at] = references[i];
+                } else if (attacks[at] != references[i]) {
+                    found = false;
+                }
+            }
+        }
+#endif
     }
-    return result;
 }
 
-std::vector<position> position::allPositions() {
-    std::vector<position> output;
-    for(int r = 1; r <= 8; ++r) {
-        for (int f = 1; f <= 8; ++f) {
-            output.emplace_back(position{f, r});
+// Random numbers of the Zobrist hashing, generated by splitmix64 at compile time.
+struct zobrist_keys {
+    std::uint64_t pieces[2][6][64] {};
+    std::uint64_t castling[16] {};
+    std::uint64_t enPassant[8] {};
+    std::uint64_t black {};
+};
+
+static constexpr zobrist_keys makeZobristKeys() {
+    zobrist_keys keys;
+    std::uint64_t state = 0x2545f4914f6cdd1d;
+    auto next = [&state]() {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    };
+    for (auto& owner: keys.pieces) {
+        for (auto& piece: owner) {
+            for (std::uint64_t& square: piece) {
+                square = next();
+            }
         }
     }
-    return output;
+    // Combinations of rights xor together the keys of the single rights.
+    std::uint64_t single[4] = {next(), next(), next(), next()};
+    for (int rights = 0; rights < 16; ++rights) {
+        for (int i = 0; i < 4; ++i) {
+            if (rights & (1 << i)) {
+                keys.castling[rights] ^= single[i];
+            }
+        }
+    }
+    for (std::uint64_t& file: keys.enPassant) {
+        file = next();
+    }
+    keys.black = next();
+    return keys;
 }
 
-bool position::operator==(position other) { return (rank == other.rank && file == other.file); }
+static constexpr zobrist_keys zobrist = makeZobristKeys();
 
-bool position::operator!=(position other) { return !(*this == other); }
+static const attack_tables& tables() {
+    static const attack_tables tables;
+    return tables;
+}
+
+static bitboard rookAttacks(int square, bitboard occupied) {
+    const attack_tables& t = tables();
+    return t.rookAttacks[t.rook[square].index(occupied)];
+}
+
+static bitboard bishopAttacks(int square, bitboard occupied) {
+    const attack_tables& t = tables();
+    return t.bishopAttacks[t.bishop[square].index(occupied)];
+}
+
+bitboard pieceAttacks(piece_type type, player owner, int square, bitboard occupied) {
+    switch (type) {
+        case piece_type::pawn:
+            return geometry.pawn[index(owner)][square];
+        case piece_type::rook:
+            return rookAttacks(square, occupied);
+        case piece_type::knight:
+            return geometry.knight[square];
+        case piece_type::bishop:
+            return bishopAttacks(square, occupied);
+        case piece_type::queen:
+            return rookAttacks(square, occupied) | bishopAttacks(square, occupied);
+        default:
+            return geometry.king[square];
+    }
+}
 
 bool chess::canMove(struct position from, struct position to, enum piece_type type, player player) {
     move m = from - to;
@@ -122,11 +344,6 @@ bool chess::canMoveQueen(move m) {
 }
 
 chess::chess() {
-
-    std::vector<std::vector<occupant>> occupants(8, std::vector<occupant>(8));
-
-
-    _occupants = occupants;
     _player = player::white;
     for (int i = 1; i <= 8; ++i) {
         placeOccupant(occupant {player::white, piece_type::pawn}, {i, 2});
@@ -149,17 +366,18 @@ chess::chess() {
 
         colour = player::black;
     }
+    updateAttacks();
 }
 
 occupant chess::at(position at) const {
     if (at == position()) {
         return occupant();
     }
-    return _occupants[at.file - 1][at.rank - 1];
+    return getOccupant(at);
 }
 
 bool chess::isBlocked(position from, position to, player player) {
-
+    stat_timer timer(counter::is_blocked);
     if (!at(to).is_empty) {
         if (at(to).owner == player) {
             return true;
@@ -168,21 +386,13 @@ bool chess::isBlocked(position from, position to, player player) {
             return true;
         }
     }
-    move dir = (to - from);
-    if (!dir.isDiagonal() && !dir.isStraight()) {
-        return false;
-    }
-    dir.directionize();
-    position pos = from + dir;
-    while (pos != to) {
-        if (!at(pos).is_empty) {
-            return true;
-        }
-        pos = pos + dir;
+    if (geometry.between[from.index()][to.index()] & _occupied) {
+        return true;
     }
     if (isCastling(from, to, player)) {
-        // In case of the queen-side castling we also need to check that the rook does pass above the vacant square.
-        return !at(to + move::horiz(-1)).is_empty;
+        // The king lands on a vacant square and in case of the queen-side castling we also need
+        // to check that the rook does pass above the vacant square.
+        return !at(to).is_empty || !at(to + move::horiz(-1)).is_empty;
     }
     return false;
 }
@@ -193,62 +403,304 @@ void chess::makeMove(position from, position to) {
 }
 
 void chess::swapPlayer() {
+    _key ^= zobrist.black;
 
     _player == player::white ? _player = player::black : _player = player::white;
 }
 
 bool chess::isChecked() {
-    position king = findKingPosition();
-    for (position p: position::allPositions()) {
-        occupant o = getOccupant(p);
-        if (!o.is_empty && o.owner != _player) {
-            if (canMove(p, king, o.piece, getOpponent()) && !isBlocked(p, king, getOpponent())) {
-                // Pawn cannot capture when the move is straight.
-                if (at(p).piece == piece_type::pawn && (king - p).isStraight()) {
-                    continue;
-                }
-                return true;
-            }
+    stat_timer timer(counter::is_checked);
+    int king = _kings[index(_player)];
+    if (king == no_square) {
+        return false;
+    }
+    if (_attacksStale) {
+        return scanAttacked(king, getOpponent());
+    }
+    return _attacks[index(getOpponent())] & squareBit(king);
+}
+
+bitboard chess::attacks(player by) {
+    if (_attacksStale) {
+        updateAttacks();
+    }
+    return _attacks[index(by)];
+}
+
+bool chess::isAttacked(position at, player by) const {
+    if (_attacksStale) {
+        return scanAttacked(at.index(), by);
+    }
+    return _attacks[index(by)] & squareBit(at.index());
+}
+
+bool chess::scanAttacked(int square, player by) const {
+    return attackersOf(square, by) != 0;
+}
+
+bitboard chess::attackersOf(int square, player by) const {
+    bitboard theirs = _colours[index(by)];
+    bitboard straight = _pieces[index(piece_type::rook)] | _pieces[index(piece_type::queen)];
+    bitboard diagonal = _pieces[index(piece_type::bishop)] | _pieces[index(piece_type::queen)];
+    // A pawn of ‹by› attacks the square iff a pawn of the opponent on the square would attack it back.
+    player other = by == player::white ? player::black : player::white;
+    return ((geometry.knight[square] & _pieces[index(piece_type::knight)]) |
+            (geometry.king[square] & _pieces[index(piece_type::king)]) |
+            (geometry.pawn[index(other)][square] & _pieces[index(piece_type::pawn)]) |
+            (rookAttacks(square, _occupied) & straight) |
+            (bishopAttacks(square, _occupied) & diagonal)) & theirs;
+}
+
+bitboard chess::computeAttacks(player by, bitboard occupied) const {
+    bitboard set = 0;
+    bitboard pieces = _colours[index(by)];
+    while (pieces) {
+        int square = popSquare(pieces);
+        switch (pieceAt(square)) {
+            case piece_type::pawn:
+                set |= geometry.pawn[index(by)][square];
+                break;
+            case piece_type::knight:
+                set |= geometry.knight[square];
+                break;
+            case piece_type::king:
+                set |= geometry.king[square];
+                break;
+            case piece_type::rook:
+                set |= rookAttacks(square, occupied);
+                break;
+            case piece_type::bishop:
+                set |= bishopAttacks(square, occupied);
+                break;
+            case piece_type::queen:
+                set |= rookAttacks(square, occupied) | bishopAttacks(square, occupied);
+                break;
         }
     }
-    return false;
+    return set;
+}
+
+void chess::updateAttacks() {
+    _attacks[index(player::white)] = computeAttacks(player::white, _occupied);
+    _attacks[index(player::black)] = computeAttacks(player::black, _occupied);
+    _attacksStale = false;
 }
 
 bool chess::wouldCheck(position from, position to) {
-    bool result = false;
-    occupant tmpTarget = at(to);
-    if (isEnPassant(from, to)) {
+    stat_timer timer(counter::would_check);
+    // The trial move is taken back right away, so the attack maps are kept as they are.
+    bitboard attacks[2] = {_attacks[0], _attacks[1]};
+    bool stale = _attacksStale;
+    player mover = _player;
+    undo_record record;
+    applyMove(ply(from, to), record);
+    bool result = _kings[index(mover)] != no_square && scanAttacked(_kings[index(mover)], _player);
+    unmakeMove(record);
+    _attacks[0] = attacks[0];
+    _attacks[1] = attacks[1];
+    _attacksStale = stale;
+    return result;
+}
 
-        occupant tmpUp = at(to + move::vert(1));
-        occupant tmpDown = at(to + move::vert(-1));
-        applyEnPassant(to);
+check_state chess::checkState() const {
+    check_state checks;
+    int king = _kings[index(_player)];
+    if (king == no_square) {
+        return checks;
+    }
+    player them = getOpponent();
+    bitboard theirs = _colours[index(them)];
+    checks.checkers = attackersOf(king, them);
+    if (checks.checkers) {
+        // Only the king can answer two checks.
+        checks.evasions = std::has_single_bit(checks.checkers)
+                              ? checks.checkers | geometry.between[king][std::countr_zero(checks.checkers)]
+                              : 0;
+    }
+    // Sliders that would attack the king if at most one own piece were out of the way.
+    bitboard straight = _pieces[index(piece_type::rook)] | _pieces[index(piece_type::queen)];
+    bitboard diagonal = _pieces[index(piece_type::bishop)] | _pieces[index(piece_type::queen)];
+    bitboard snipers = ((rookAttacks(king, theirs) & straight) | (bishopAttacks(king, theirs) & diagonal)) & theirs;
+    while (snipers) {
+        bitboard blockers = geometry.between[king][popSquare(snipers)] & _occupied;
+        if (std::has_single_bit(blockers) && !(blockers & theirs)) {
+            checks.pinned |= blockers;
+        }
+    }
+    checks.kingDanger = computeAttacks(them, _occupied & ~squareBit(king));
+    return checks;
+}
 
+bool chess::wouldCheck(position from, position to, const check_state& checks) {
+    int origin = from.index();
+    int target = to.index();
+    int king = _kings[index(_player)];
+    if (origin == king) {
+        return checks.kingDanger & squareBit(target);
+    }
+    // Taking «en passant» removes a piece off the target square, which may uncover the king.
+    if (isEnPassant(from, to)) {
+        return wouldCheck(from, to);
+    }
+    if (!(checks.evasions & squareBit(target))) {
+        return true;
+    }
+    return (checks.pinned & squareBit(origin)) && !(geometry.line[king][origin] & squareBit(target));
+}
 
-        makeMove(from, to);
-        if (isChecked()) {
-            result = true;
+void chess::applyMove(ply p, undo_record& record) {
+    position from = p.origin();
+    position to = p.target();
+    record.move = p;
+    record.lapsable = _lapsable;
+    record.key = key();
+    record.halfmoveClock = _halfmoveClock;
+    record.reversible = _reversible;
+    record.flags = 0;
+    if (_moved & squareBit(p.from)) {
+        record.flags |= undo_record::mover_moved;
+    }
+    if (_twoStep & squareBit(p.from)) {
+        record.flags |= undo_record::mover_two_step;
+    }
+    position taken = to;
+    if (isEnPassant(from, to)) {
+        record.flags |= undo_record::en_passant;
+        taken = to + move::vert(_player == player::white ? -1 : 1);
+    }
+    if (_occupied & squareBit(taken.index())) {
+        record.flags |= undo_record::capture;
+        record.captured = pieceAt(taken.index());
+        if (_moved & squareBit(taken.index())) {
+            record.flags |= undo_record::captured_moved;
         }
-        makeMove(to, from);
-        placeOccupant(tmpUp, to +  move::vert(1));
-        placeOccupant(tmpDown, to + move::vert(-1));
+        if (_twoStep & squareBit(taken.index())) {
+            record.flags |= undo_record::captured_two_step;
+        }
+    }
+    bool castling = isCastling(from, to, _player);
+    if (castling) {
+        record.flags |= undo_record::castling;
+    }
+    piece_type mover = pieceAt(p.from);
+    bool pawnOrCapture = mover == piece_type::pawn || (record.flags & undo_record::capture);
+    _halfmoveClock = pawnOrCapture ? 0 : static_cast<std::uint16_t>(std::min(_halfmoveClock + 1, 65535));
+    // The first move of a king or a rook may take castling rights away, which is checked below.
+    bool firstMove = (mover == piece_type::king || mover == piece_type::rook) && !(record.flags & undo_record::mover_moved);
+    std::uint8_t rights = firstMove ? castlingRights() : 0;
+    _reversible = pawnOrCapture ? 0 : static_cast<std::uint8_t>(std::min(_reversible + 1, move_history::size - 1));
+    if (_player == player::black) {
+        ++_fullmove;
+    }
+
+    // Whatever could be taken «en passant» now cannot be after this move.
+    _lapsable = 0;
+    if (p.promote != piece_type::pawn) {
+        applyPromote(from, p.promote);
+    }
+    if (record.flags & undo_record::en_passant) {
+        applyEnPassant(to);
+    }
+    setFlags(from, to);
+    if (castling) {
+        makeCastling(from, to);
     } else {
         makeMove(from, to);
-        if (isChecked()) {
-            result = true;
-        }
-        makeMove(to, from);
     }
-    placeOccupant(tmpTarget, to);
-    return result;
+    if (firstMove && castlingRights() != rights) {
+        _reversible = 0;
+    }
+    swapPlayer();
 }
 
-result chess::play(position from, position to, piece_type promote /* = piece_type::pawn */) {
+void chess::makeMove(ply p, undo_record& record) {
+    applyMove(p, record);
+    updateAttacks();
+}
 
+void chess::makeNullMove(undo_record& record) {
+    record.move = ply();
+    record.lapsable = _lapsable;
+    record.key = key();
+    record.halfmoveClock = _halfmoveClock;
+    record.reversible = _reversible;
+    record.flags = undo_record::null_move;
+    _lapsable = 0;
+    _halfmoveClock = static_cast<std::uint16_t>(std::min(_halfmoveClock + 1, 65535));
+    // A repetition across a null move is not a real one.
+    _reversible = 0;
+    if (_player == player::black) {
+        ++_fullmove;
+    }
+    swapPlayer();
+}
 
+bool chess::isCapture(ply p) const {
+    bitboard target = squareBit(p.to);
+    if (_occupied & target) {
+        return true;
+    }
+    // A pawn leaving its file without a piece to take can only take «en passant».
+    return (_pieces[index(piece_type::pawn)] & squareBit(p.from)) && (p.from - p.to) % 8 != 0;
+}
 
-    restartLapses();
-    bool wasChecked = isChecked();
+void chess::unmakeMove(const undo_record& record) {
+    swapPlayer();
+    _halfmoveClock = record.halfmoveClock;
+    _reversible = record.reversible;
+    if (_player == player::black) {
+        --_fullmove;
+    }
+    if (record.flags & undo_record::null_move) {
+        // The pieces are where they were, so are the attack maps.
+        _lapsable = record.lapsable;
+        return;
+    }
+    position from = record.move.origin();
+    position to = record.move.target();
+
+    occupant mover = getOccupant(to);
+    mover.didMove = record.flags & undo_record::mover_moved;
+    mover.didTwoStep = record.flags & undo_record::mover_two_step;
+    if (record.move.promote != piece_type::pawn) {
+        mover.piece = piece_type::pawn;
+    }
+    placeOccupant(occupant(), to);
+    placeOccupant(mover, from);
+    if (record.flags & undo_record::castling) {
+        if ((to - from).file == 2) {
+            makeMove(to + move::horiz(-1), to + move::horiz(1));
+        } else {
+            makeMove(to + move::horiz(1), to + move::horiz(-2));
+        }
+    }
+    if (record.flags & undo_record::capture) {
+        occupant captured {getOpponent(), record.captured};
+        captured.didMove = record.flags & undo_record::captured_moved;
+        captured.didTwoStep = record.flags & undo_record::captured_two_step;
+        position taken = to;
+        if (record.flags & undo_record::en_passant) {
+            taken = to + move::vert(_player == player::white ? -1 : 1);
+        }
+        placeOccupant(captured, taken);
+    }
+    _lapsable = record.lapsable;
+    _attacksStale = true;
+}
 
+bool chess::undo(move_history& history) {
+    if (history.count() == 0) {
+        return false;
+    }
+    unmakeMove(history);
+    return true;
+}
+
+result chess::validate(position from, position to, bool wasChecked) {
+    return checkMove(from, to, wasChecked, checkState());
+}
+
+result chess::checkMove(position from, position to, bool wasChecked, const check_state& checks) {
     if (at(from).is_empty) {
         return result::no_piece;
     }
@@ -269,42 +721,313 @@ result chess::play(position from, position to, piece_type promote /* = piece_typ
         if (wasChecked) {
             return result::in_check;
         }
-        if (wouldCheckCastling(from, to)) {
+        if (wouldCheckCastling(from, to, checks)) {
             return result::would_check;
         }
         if (hasMoved(from, to)) {
             return result::has_moved;
         }
-    } else if (wouldCheck(from, to)) {
+    } else if (wouldCheck(from, to, checks)) {
         if (wasChecked) {
             return result::in_check;
         }
         return result::would_check;
     }
+    return result::ok;
+}
+
+result chess::play(position from, position to, piece_type promote /* = piece_type::pawn */) {
+    undo_record record;
+    return playMove(from, to, promote, record);
+}
+
+result chess::play(position from, position to, piece_type promote, move_history& history) {
+    undo_record record;
+    result r = playMove(from, to, promote, record);
+    if (r <= result::ok) {
+        history.push() = record;
+    }
+    return r;
+}
+
+result chess::playMove(position from, position to, piece_type promote, undo_record& record) {
+    stat_timer timer(counter::play);
+    restartLapses();
+    result valid = validate(from, to, isChecked());
+    if (valid != result::ok) {
+        return valid;
+    }
     if (isPromote(from, to)) {
         if (!isValidPromote(promote)) {
             return result::bad_promote;
         }
-        applyPromote(from, promote);
+    } else {
+        promote = piece_type::pawn;
     }
-
-
     result result = result::ok;
     if (!at(to).is_empty || isEnPassant(from, to)) {
         result = result::capture;
     }
-    if (isEnPassant(from, to)) {
-        applyEnPassant(to);
+    makeMove(ply(from, to, promote), record);
+    return result;
+}
+
+std::string ply::toString() const {
+    std::string text {char('a' + from % 8), char('1' + from / 8), char('a' + to % 8), char('1' + to / 8)};
+    switch (promote) {
+        case piece_type::rook:
+            text += 'r';
+            break;
+        case piece_type::knight:
+            text += 'n';
+            break;
+        case piece_type::bishop:
+            text += 'b';
+            break;
+        case piece_type::queen:
+            text += 'q';
+            break;
+        default:
+            break;
     }
-    setFlags(from, to);
-    if (isCastling(from, to, _player)) {
-        makeCastling(from, to);
-    } else {
-        makeMove(from, to);
+    return text;
+}
+
+bool ply::fromString(std::string_view text, ply& out) {
+    if (text.size() != 4 && text.size() != 5) {
+        return false;
     }
-    swapPlayer();
-    return result;
- }
+    for (int i: {0, 2}) {
+        if (text[i] < 'a' || text[i] > 'h' || text[i + 1] < '1' || text[i + 1] > '8') {
+            return false;
+        }
+    }
+    piece_type promote = piece_type::pawn;
+    if (text.size() == 5) {
+        switch (text[4]) {
+            case 'r':
+                promote = piece_type::rook;
+                break;
+            case 'n':
+                promote = piece_type::knight;
+                break;
+            case 'b':
+                promote = piece_type::bishop;
+                break;
+            case 'q':
+                promote = piece_type::queen;
+                break;
+            default:
+                return false;
+        }
+    }
+    out = ply(position{text[0] - 'a' + 1, text[1] - '0'}, position{text[2] - 'a' + 1, text[3] - '0'}, promote);
+    return true;
+}
+
+bool ply_list::contains(ply p) const {
+    for (ply m: *this) {
+        if (m == p) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bitboard chess::candidateTargets(position from, piece_type type) {
+    bitboard targets = 0;
+    auto step = [&](move m) {
+        position to = from + m;
+        if (to != position()) {
+            targets |= squareBit(to.index());
+        }
+    };
+    switch (type) {
+        case piece_type::pawn: {
+            int p = _player == player::white ? 1 : -1;
+            for (move m: {move::vert(p), move::vert(2 * p), move{1, p}, move{-1, p}}) {
+                step(m);
+            }
+            break;
+        }
+        case piece_type::knight:
+            targets = geometry.knight[from.index()];
+            break;
+        case piece_type::king:
+            targets = geometry.king[from.index()];
+            step(move::horiz(2));
+            step(move::horiz(-2));
+            break;
+        // The rays stop at the first occupied square, ‹validate› decides whether it can be captured.
+        case piece_type::rook:
+            targets = rookAttacks(from.index(), _occupied);
+            break;
+        case piece_type::bishop:
+            targets = bishopAttacks(from.index(), _occupied);
+            break;
+        default:
+            targets = rookAttacks(from.index(), _occupied) | bishopAttacks(from.index(), _occupied);
+            break;
+    }
+    return targets & ~_colours[index(_player)];
+}
+
+void chess::generateLegalMoves(ply_list& list, move_filter filter /* = move_filter::all */) {
+    stat_timer timer(counter::generate);
+    list.size = 0;
+    check_state checks = checkState();
+    bool wasChecked = checks.checkers != 0;
+    int king = _kings[index(_player)];
+    bitboard noisy = _colours[index(getOpponent())];
+    // A pawn also makes noise on the last rank and when it takes «en passant».
+    bitboard pawnNoisy = noisy | (_player == player::white ? 0xff00000000000000 : 0xff);
+    position lapse = enPassantTarget();
+    if (lapse != position()) {
+        pawnNoisy |= squareBit(lapse.index());
+    }
+    bitboard own = _colours[index(_player)];
+    while (own) {
+        int from = popSquare(own);
+        position origin = position::fromIndex(from);
+        piece_type type = pieceAt(from);
+        bitboard targets = candidateTargets(origin, type);
+        if (filter != move_filter::all) {
+            bitboard wanted = type == piece_type::pawn ? pawnNoisy : noisy;
+            targets &= filter == move_filter::noisy ? wanted : ~wanted;
+        }
+        // Most moves are ruled out by the checks and pins at once, an «en passant» is left to
+        // ‹checkMove› as it takes the checker off another square.
+        if (type != piece_type::king && type != piece_type::pawn) {
+            targets &= checks.evasions;
+            if (checks.pinned & squareBit(from)) {
+                targets &= geometry.line[king][from];
+            }
+        }
+        while (targets) {
+            int to = popSquare(targets);
+            position target = position::fromIndex(to);
+            if (checkMove(origin, target, wasChecked, checks) != result::ok) {
+                continue;
+            }
+            ply p {from, to};
+            if (isPromote(origin, target)) {
+                for (piece_type promote: {piece_type::queen, piece_type::rook,
+                                          piece_type::bishop, piece_type::knight}) {
+                    p.promote = promote;
+                    list.push(p);
+                }
+            } else {
+                list.push(p);
+            }
+        }
+    }
+    countStat(counter::generated_moves, list.size);
+}
+
+void chess::classifyMoves(move_table& out) {
+    bool wasChecked = isChecked();
+    check_state checks = checkState();
+    for (int from = 0; from < 64; ++from) {
+        out.targets[from] = 0;
+        position origin = position::fromIndex(from);
+        occupant mover = at(origin);
+        if (mover.is_empty || mover.owner != _player) {
+            std::fill(std::begin(out.results[from]), std::end(out.results[from]),
+                      mover.is_empty ? result::no_piece : result::bad_piece);
+            continue;
+        }
+        std::fill(std::begin(out.results[from]), std::end(out.results[from]), result::bad_move);
+        // Squares the piece could reach on an empty board, every other one is a ‹bad_move›.
+        bitboard reach = pieceAttacks(mover.piece, _player, from, 0) | squareBit(from);
+        if (mover.piece == piece_type::pawn) {
+            reach |= _player == player::white ? squareBit(from) << 8 | squareBit(from) << 16
+                                              : squareBit(from) >> 8 | squareBit(from) >> 16;
+        } else if (mover.piece == piece_type::king) {
+            for (move castling: {move::horiz(2), move::horiz(-2)}) {
+                position to = origin + castling;
+                if (to != position()) {
+                    reach |= squareBit(to.index());
+                }
+            }
+        }
+        while (reach) {
+            int to = popSquare(reach);
+            result r = checkMove(origin, position::fromIndex(to), wasChecked, checks);
+            out.results[from][to] = r;
+            if (r == result::ok) {
+                out.targets[from] |= squareBit(to);
+            }
+        }
+    }
+}
+
+bool chess::hasLegalMove() {
+    bool wasChecked = isChecked();
+    check_state checks = checkState();
+    bitboard own = _colours[index(_player)];
+    while (own) {
+        int from = popSquare(own);
+        position origin = position::fromIndex(from);
+        bitboard targets = candidateTargets(origin, pieceAt(from));
+        while (targets) {
+            if (checkMove(origin, position::fromIndex(popSquare(targets)), wasChecked, checks) == result::ok) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int chess::repetitions(const move_history& history) const {
+    int count = 0;
+    int window = std::min<int>(_reversible, history.count());
+    // The full key, so that an «en passant» capture that has lapsed tells the positions apart.
+    std::uint64_t current = key();
+    // It takes at least four plies to get back to a position.
+    for (int back = 4; back <= window; back += 2) {
+        count += history.last(back).key == current;
+    }
+    return count;
+}
+
+bool chess::isInsufficientMaterial() const {
+    if (_pieces[index(piece_type::pawn)] | _pieces[index(piece_type::rook)] | _pieces[index(piece_type::queen)]) {
+        return false;
+    }
+    bitboard knights = _pieces[index(piece_type::knight)];
+    bitboard bishops = _pieces[index(piece_type::bishop)];
+    if (std::popcount(knights | bishops) <= 1) {
+        return true;
+    }
+    // Bishops that all stand on squares of one colour can never give mate.
+    constexpr bitboard light = 0x55aa55aa55aa55aa;
+    return !knights && (!(bishops & light) || !(bishops & ~light));
+}
+
+game_status chess::status(const move_history& history) {
+    if (!hasLegalMove()) {
+        return isChecked() ? game_status::checkmate : game_status::stalemate;
+    }
+    if (isInsufficientMaterial()) {
+        return game_status::insufficient_material;
+    }
+    if (_halfmoveClock >= 100) {
+        return game_status::fifty_moves;
+    }
+    if (repetitions(history) >= 2) {
+        return game_status::repetition;
+    }
+    return game_status::ongoing;
+}
+
+bool chess::isLegal(ply p) {
+    position from = p.origin();
+    position to = p.target();
+    if (from == to || validate(from, to, isChecked()) != result::ok) {
+        return false;
+    }
+    return isPromote(from, to) ? isValidPromote(p.promote) : p.promote == piece_type::pawn;
+}
 
 void chess::print() {
     for (int r = 8; r >= 1; --r) {
@@ -365,55 +1088,129 @@ void chess::print() {
     std::cout << "-----------------\n";
 }
 
-occupant &chess::getOccupant(position at) {
-    return _occupants[at.file - 1][at.rank - 1];
+piece_type chess::pieceAt(int square) const {
+    bitboard bit = squareBit(square);
+    for (piece_type piece: {piece_type::pawn, piece_type::rook, piece_type::knight,
+                            piece_type::bishop, piece_type::queen, piece_type::king}) {
+        if (_pieces[index(piece)] & bit) {
+            return piece;
+        }
+    }
+    return piece_type::pawn;
+}
+
+void chess::clearSquare(int square) {
+    bitboard bit = squareBit(square);
+    if (_occupied & bit) {
+        player owner = (_colours[index(player::black)] & bit) ? player::black : player::white;
+        _key ^= zobrist.pieces[index(owner)][index(pieceAt(square))][square];
+        addPsqt(owner, pieceAt(square), square, -1);
+    }
+    bitboard keep = ~bit;
+    for (bitboard& set: _pieces) {
+        set &= keep;
+    }
+    _colours[0] &= keep;
+    _colours[1] &= keep;
+    _occupied &= keep;
+    _moved &= keep;
+    _twoStep &= keep;
+    _lapsable &= keep;
+    for (std::uint8_t& king: _kings) {
+        if (king == square) {
+            king = no_square;
+        }
+    }
+    _attacksStale = true;
+}
+
+occupant chess::getOccupant(position at) const {
+    int square = at.index();
+    bitboard bit = squareBit(square);
+    occupant o;
+    if (!(_occupied & bit)) {
+        return o;
+    }
+    o.is_empty = false;
+    o.owner = (_colours[index(player::black)] & bit) ? player::black : player::white;
+    o.piece = pieceAt(square);
+    o.didMove = _moved & bit;
+    o.didTwoStep = _twoStep & bit;
+    o.canBeLapsed = _lapsable & bit;
+    return o;
+}
+
+void chess::addPsqt(player owner, piece_type piece, int square, int sign) {
+    _middlegame += sign * psqtValue(false, owner, piece, square);
+    _endgame += sign * psqtValue(true, owner, piece, square);
 }
 
 void chess::placeOccupant(occupant occupant, position at) {
-    _occupants[at.file - 1][at.rank - 1] = occupant;
+    int square = at.index();
+    clearSquare(square);
+    if (occupant.is_empty) {
+        return;
+    }
+    bitboard bit = squareBit(square);
+    _key ^= zobrist.pieces[index(occupant.owner)][index(occupant.piece)][square];
+    addPsqt(occupant.owner, occupant.piece, square, 1);
+    _pieces[index(occupant.piece)] |= bit;
+    _colours[index(occupant.owner)] |= bit;
+    _occupied |= bit;
+    if (occupant.piece == piece_type::king) {
+        _kings[index(occupant.owner)] = square;
+    }
+    if (occupant.didMove) {
+        _moved |= bit;
+    }
+    if (occupant.didTwoStep) {
+        _twoStep |= bit;
+    }
+    if (occupant.canBeLapsed) {
+        _lapsable |= bit;
+    }
 }
 
 void chess::setFlags(position from, position to) {
-    if (at(from).piece == piece_type::pawn) {
+    bitboard bit = squareBit(from.index());
+    if (_pieces[index(piece_type::pawn)] & bit) {
         if (move::abs(to - from) == move::vert(2)) {
-            getOccupant(from).didTwoStep = true;
-            getOccupant(from).canBeLapsed = true;
+            _twoStep |= bit;
+            _lapsable |= bit;
         } else {
-            getOccupant(from).didTwoStep = false;
+            _twoStep &= ~bit;
         }
     }
-    getOccupant(from).didMove = true;
+    _moved |= bit;
 }
 
 position chess::findKingPosition() {
-    for (position p: position::allPositions()) {
-        occupant o = getOccupant(p);
+    return kingPosition(_player);
+}
 
-        if (!o.is_empty && o.piece == piece_type::king && o.owner == _player) {
-            return p;
-        }
+position chess::kingPosition(player owner) const {
+    int king = _kings[index(owner)];
+    if (king == no_square) {
+        return position();
     }
-    return position();
+    return position::fromIndex(king);
 }
 
-player chess::getOpponent() {
+player chess::getOpponent() const {
     return _player == player::white ? player::black : player::white;
 }
 
 void chess::restartLapses() {
-    for(position p: position::allPositions()) {
-        occupant& o = getOccupant(p);
-        if (!o.is_empty && o.owner == _player && o.piece == piece_type::pawn) {
-            o.canBeLapsed = false;
-        }
-    }
+    _lapsable &= ~_colours[index(_player)];
 }
 
 bool chess::isLapsed(position from, position to) {
     int p;
     _player == player::white ? p = -1 : p = 1;
     occupant toLapse = at(to + move::vert(p));
-    if (at(from).piece == piece_type::pawn && toLapse.owner == getOpponent() && toLapse.didTwoStep) {
+    // Only a move to a vacant square can be an «en passant».
+    if (at(from).piece == piece_type::pawn && at(to).is_empty && toLapse.owner == getOpponent() &&
+        toLapse.didTwoStep) {
         return !toLapse.canBeLapsed;
     }
     return false;
@@ -423,7 +1220,8 @@ bool chess::isEnPassant(position from, position to) {
     int p;
     _player == player::white ? p = -1 : p = 1;
     occupant toLapse = at(to + move::vert(p));
-    return (at(from).piece == piece_type::pawn && toLapse.owner == getOpponent() && toLapse.canBeLapsed);
+    return (at(from).piece == piece_type::pawn && at(to).is_empty && toLapse.owner == getOpponent() &&
+            toLapse.canBeLapsed);
 }
 
 void chess::applyEnPassant(position at) {
@@ -438,16 +1236,19 @@ bool chess::isCastling(position from, position to, player player) {
     int p;
     player == player::white ? p = 1 : p = 8;
 
-    return from == position{5, p} &&
+    return from == position{5, p} && (_pieces[index(piece_type::king)] & squareBit(from.index())) &&
            ((m == move::horiz(2) && at({8, p}).piece == piece_type::rook && at({8, p}).owner == player) ||
             (m == move::horiz(-2) && at({1, p}).piece == piece_type::rook && at({1, p}).owner == player));
 }
 
 bool chess::wouldCheckCastling(position from, position to) {
-    move m = to - from;
-    int p;
-    m.file == 2 ? p = 1 : p = -1;
-    return (wouldCheck(from, from + move::horiz(p)) || wouldCheck(from, from + move::horiz(2 * p)));
+    return wouldCheckCastling(from, to, checkState());
+}
+
+bool chess::wouldCheckCastling(position from, position to, const check_state& checks) const {
+    // The king passes the squares up to the one beyond its target.
+    int beyond = to.index() + (to.file > from.file ? 1 : -1);
+    return checks.kingDanger & geometry.between[from.index()][beyond];
 }
 
 bool chess::hasMoved(position from, position to) {
@@ -472,8 +1273,15 @@ bool chess::isValidPromote(piece_type promote) {
 }
 
 void chess::applyPromote(position at, piece_type promote) {
-    //placeOccupant(occupant{_player, promote}, at);
-    getOccupant(at).piece = promote;
+    int square = at.index();
+    bitboard bit = squareBit(square);
+    _key ^= zobrist.pieces[index(_player)][index(piece_type::pawn)][square] ^
+            zobrist.pieces[index(_player)][index(promote)][square];
+    addPsqt(_player, piece_type::pawn, square, -1);
+    addPsqt(_player, promote, square, 1);
+    _pieces[index(piece_type::pawn)] &= ~bit;
+    _pieces[index(promote)] |= bit;
+    _attacksStale = true;
 }
 
 void chess::makeCastling(position from, position to) {
@@ -488,102 +1296,274 @@ void chess::makeCastling(position from, position to) {
     placeOccupant(occupant(), from);
 }
 
-/* ##### TESTS ############################################################################## */
-
-void test_enpassant() {
-    chess my_chess = chess();
-    my_chess.play({4, 2}, {4, 4});
-    my_chess.play({1, 7}, {1, 6});
-    my_chess.play({4, 4}, {4, 5});
-    my_chess.print();
-    assert (!my_chess.getOccupant({4, 5}).canBeLapsed);
-    my_chess.play({3, 7}, {3, 5});
-    my_chess.print();
-    assert (my_chess.getOccupant({3, 5}).canBeLapsed);
-    assert (my_chess.play({4, 5}, {3, 6}) == result::capture);
-    my_chess.print();
-}
-
-void test_castling() {
-    chess my_chess = chess();
-    // big white
-    my_chess.placeOccupant(occupant(),{2, 1});
-    my_chess.placeOccupant(occupant(),{3, 1});
-    my_chess.placeOccupant(occupant(),{4, 1});
-    my_chess.print();
-    my_chess.play({5, 1}, {3, 1});
-    my_chess.print();
-    // small black
-    my_chess.placeOccupant(occupant(),{6, 8});
-    my_chess.placeOccupant(occupant(),{7, 8});
-    my_chess.print();
-    my_chess.play({5, 8}, {7, 8});
-    my_chess.print();
-}
-
-void test_promote() {
-    chess my_chess = chess();
-    my_chess.play({2, 2},{2, 4});
-    my_chess.play({6, 7},{6, 5});
-    my_chess.play({2, 4},{2, 5});
-    my_chess.play({6, 5},{6, 4});
-    my_chess.print();
-    my_chess.play({3, 2},{3, 4});
-    my_chess.print();
-    my_chess.play({6, 4},{6, 3});
-    my_chess.print();
-    my_chess.play({3, 4},{3, 5});
-    my_chess.print();
-    my_chess.play({2, 7},{2, 6});
-    my_chess.print();
-    my_chess.play({3, 5},{2, 6});
-    my_chess.print();
-    my_chess.play({2, 8},{3, 6});
-    my_chess.print();
-    my_chess.play({2, 6},{1, 7});
-    my_chess.print();
-    my_chess.play({1, 8},{2, 8});
-    my_chess.print();
-    my_chess.play({1, 7},{2, 8}, piece_type::bishop);
-    my_chess.print();
-    my_chess.play({6, 3}, {5, 2});
-    my_chess.print();
-    assert( my_chess.play({2, 8}, {3, 7}) == result::capture);
-    my_chess.print();
-
-}
-
-int main()
-{
-    chess my_chess = chess();
-    my_chess.print();
-    position a7 = {1, 7};
-    position a6 = {1, 6};
-    assert( my_chess.play( a7, a6 ) == result::bad_piece);
-    test_enpassant();
-    test_castling();
-    test_promote();
-
-    chess c = chess();
-    assert(c.play( {1, 2}, {1, 4} ) == result::ok);
-    assert(c.play( {1, 7}, {1, 5} ) == result::ok);
-    assert(c.play( {1, 4}, {1, 5} ) == result::blocked);
-
-    assert(c.play( {7, 2}, {7, 3} ) == result::ok);
-    assert(c.play( {7, 7}, {7, 6} ) == result::ok);
-    assert(c.play( {6, 1}, {8, 3} ) == result::ok);
-    assert(c.play( {7, 8}, {6, 6} ) == result::ok);
-    assert(c.play( {7, 1}, {6, 3} ) == result::ok);
-    assert(c.play( {6, 8}, {8, 6} ) == result::ok);
-    c.print();
-    assert(c.play( {8, 1}, {7, 1} ) == result::ok);
-    c.print();
-    assert(c.play( {5, 7}, {5, 6} ) == result::ok);
-    c.print();
-    assert(c.play( {7, 1}, {8, 1} ) == result::ok);
-    c.print();
-    assert(c.play( {6, 6}, {8, 5} ) == result::ok);
-    c.print();
-    assert(c.play( {5, 1}, {7, 1} ) == result::has_moved);
+std::uint64_t chess::perft(int depth) {
+    ply_list list;
+    generateLegalMoves(list);
+    if (depth <= 1) {
+        return depth == 1 ? list.size : 1;
+    }
+    std::uint64_t nodes = 0;
+    undo_record record;
+    for (ply p: list) {
+        makeMove(p, record);
+        nodes += perft(depth - 1);
+        unmakeMove(record);
+    }
+    return nodes;
+}
+
+std::uint8_t chess::castlingRights() const {
+    // Squares whose pieces have to be in place and unmoved for each right.
+    static const struct {
+        player owner;
+        int king;
+        int rook;
+        std::uint8_t right;
+    } corners[] = {{player::white, 4, 7, white_king_side}, {player::white, 4, 0, white_queen_side},
+                   {player::black, 60, 63, black_king_side}, {player::black, 60, 56, black_queen_side}};
+    std::uint8_t rights = 0;
+    for (const auto& c: corners) {
+        bitboard king = squareBit(c.king) & _pieces[index(piece_type::king)];
+        bitboard rook = squareBit(c.rook) & _pieces[index(piece_type::rook)];
+        if (((king | rook) & _colours[index(c.owner)] & ~_moved) == (squareBit(c.king) | squareBit(c.rook))) {
+            rights |= c.right;
+        }
+    }
+    return rights;
+}
+
+position chess::enPassantTarget() const {
+    bitboard lapsable = _lapsable & _colours[index(getOpponent())] & _pieces[index(piece_type::pawn)];
+    if (!lapsable) {
+        return position();
+    }
+    int square = std::countr_zero(lapsable);
+    return position::fromIndex(_player == player::white ? square + 8 : square - 8);
+}
+
+stats_snapshot chess::stats() {
+    return takeStats();
+}
+
+std::uint64_t chess::key() const {
+    std::uint64_t key = _key ^ zobrist.castling[castlingRights()];
+    position target = enPassantTarget();
+    if (target != position()) {
+        // Only when one of our pawns can take, otherwise the position is the same.
+        bitboard takers = geometry.pawn[index(getOpponent())][target.index()] &
+                          _pieces[index(piece_type::pawn)] & _colours[index(_player)];
+        if (takers) {
+            key ^= zobrist.enPassant[target.file - 1];
+        }
+    }
+    return key;
+}
+
+// Letters of the black pieces in FEN indexed by ‹piece_type›, white uses upper case.
+static constexpr char piece_letters[] = "prnbqk";
+
+// Index of ‹letter› in ‹piece_letters› in either case, -1 if it is not a piece.
+static int pieceIndex(char letter) {
+    if (letter >= 'A' && letter <= 'Z') {
+        letter += 'a' - 'A';
+    }
+    for (int i = 0; i < 6; ++i) {
+        if (piece_letters[i] == letter) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool chess::fromFEN(std::string_view fen) {
+    const bitboard rank1 = 0xff;
+    bitboard pieces[6] {};
+    bitboard colours[2] {};
+    std::size_t i = 0;
+    auto next = [&]() { return i < fen.size() ? fen[i++] : '\0'; };
+
+    // Placement from a8 to h1.
+    int rank = 7;
+    int file = 0;
+    for (char c = next(); c != ' '; c = next()) {
+        if (c == '/' && file == 8 && rank > 0) {
+            --rank;
+            file = 0;
+        } else if (c >= '1' && c <= '8' && file + (c - '0') <= 8) {
+            file += c - '0';
+        } else {
+            int piece = pieceIndex(c);
+            if (piece < 0 || file == 8) {
+                return false;
+            }
+            bitboard bit = squareBit(rank * 8 + file);
+            pieces[piece] |= bit;
+            colours[c >= 'a' ? index(player::black) : index(player::white)] |= bit;
+            ++file;
+        }
+    }
+    bitboard kings = pieces[index(piece_type::king)];
+    if (rank != 0 || file != 8 || (pieces[index(piece_type::pawn)] & (rank1 | rank1 << 56)) ||
+        std::popcount(kings & colours[0]) != 1 || std::popcount(kings & colours[1]) != 1) {
+        return false;
+    }
+
+    char side = next();
+    if ((side != 'w' && side != 'b') || next() != ' ') {
+        return false;
+    }
+    player mover = side == 'w' ? player::white : player::black;
+
+    std::uint8_t rights = 0;
+    char c = next();
+    if (c == '-') {
+        c = next();
+    } else {
+        for (; c != ' ' && c != '\0'; c = next()) {
+            const char* letters = "KQkq";
+            int right = 0;
+            while (right < 4 && letters[right] != c) {
+                ++right;
+            }
+            if (right == 4) {
+                return false;
+            }
+            rights |= 1 << right;
+        }
+    }
+    if (c != ' ') {
+        return false;
+    }
+
+    // The pawn that has just moved two squares, if any.
+    bitboard twoStep = 0;
+    c = next();
+    if (c != '-') {
+        char r = next();
+        // White has just moved if black is to move and the other way around.
+        char expected = mover == player::black ? '3' : '6';
+        if (c < 'a' || c > 'h' || r != expected) {
+            return false;
+        }
+        int target = (r - '1') * 8 + (c - 'a');
+        twoStep = squareBit(mover == player::black ? target + 8 : target - 8);
+        if (!(twoStep & pieces[index(piece_type::pawn)] & colours[index(mover == player::black ? player::white
+                                                                                                   : player::black)])) {
+            return false;
+        }
+    }
+
+    // Optional halfmove clock and fullmove number, trailing whitespace is ignored.
+    int counters[2] = {0, 1};
+    for (int n = 0; i < fen.size() && n < 2 && fen[i] == ' '; ++n) {
+        ++i;
+        std::size_t digits = i;
+        counters[n] = 0;
+        while (i < fen.size() && fen[i] >= '0' && fen[i] <= '9') {
+            counters[n] = std::min(counters[n] * 10 + (fen[i] - '0'), 65535);
+            ++i;
+        }
+        if (i == digits) {
+            return false;
+        }
+    }
+    for (; i < fen.size(); ++i) {
+        if (fen[i] != ' ' && fen[i] != '\t' && fen[i] != '\r' && fen[i] != '\n') {
+            return false;
+        }
+    }
 
+    _player = mover;
+    _occupied = colours[0] | colours[1];
+    _key = mover == player::black ? zobrist.black : 0;
+    _middlegame = 0;
+    _endgame = 0;
+    for (int owner = 0; owner < 2; ++owner) {
+        _colours[owner] = colours[owner];
+        _kings[owner] = static_cast<std::uint8_t>(std::countr_zero(kings & colours[owner]));
+        for (int piece = 0; piece < 6; ++piece) {
+            bitboard set = pieces[piece] & colours[owner];
+            while (set) {
+                int square = popSquare(set);
+                _key ^= zobrist.pieces[owner][piece][square];
+                addPsqt(static_cast<player>(owner), static_cast<piece_type>(piece), square, 1);
+            }
+        }
+    }
+    for (int piece = 0; piece < 6; ++piece) {
+        _pieces[piece] = pieces[piece];
+    }
+
+    bitboard homePawns = (colours[index(player::white)] & rank1 << 8) | (colours[index(player::black)] & rank1 << 48);
+    _moved = (pieces[index(piece_type::pawn)] & ~homePawns) | kings | pieces[index(piece_type::rook)];
+    // King and rook squares of ‹castling› rights in the order of their bits.
+    static const int corners[4][2] = {{4, 7}, {4, 0}, {60, 63}, {60, 56}};
+    for (int right = 0; right < 4; ++right) {
+        bitboard king = squareBit(corners[right][0]);
+        bitboard rook = squareBit(corners[right][1]);
+        bitboard own = colours[right < 2 ? index(player::white) : index(player::black)];
+        // A right without its pieces in place cannot be represented and is dropped.
+        if ((rights & (1 << right)) && (kings & own & king) && (pieces[index(piece_type::rook)] & own & rook)) {
+            _moved &= ~(king | rook);
+        }
+    }
+    _twoStep = twoStep;
+    _lapsable = twoStep;
+
+    _halfmoveClock = static_cast<std::uint16_t>(counters[0]);
+    _fullmove = static_cast<std::uint16_t>(std::max(counters[1], 1));
+    _reversible = 0;
+    updateAttacks();
+    return true;
+}
+
+int chess::toFEN(char* out) const {
+    char* p = out;
+    for (int rank = 7; rank >= 0; --rank) {
+        int empty = 0;
+        for (int square = rank * 8; square < rank * 8 + 8; ++square) {
+            if (!(_occupied & squareBit(square))) {
+                ++empty;
+                continue;
+            }
+            if (empty) {
+                *p++ = static_cast<char>('0' + empty);
+                empty = 0;
+            }
+            char letter = piece_letters[index(pieceAt(square))];
+            *p++ = _colours[index(player::white)] & squareBit(square) ? static_cast<char>(letter - 'a' + 'A') : letter;
+        }
+        if (empty) {
+            *p++ = static_cast<char>('0' + empty);
+        }
+        if (rank) {
+            *p++ = '/';
+        }
+    }
+    *p++ = ' ';
+    *p++ = _player == player::white ? 'w' : 'b';
+    *p++ = ' ';
+    std::uint8_t rights = castlingRights();
+    if (!rights) {
+        *p++ = '-';
+    }
+    for (int right = 0; right < 4; ++right) {
+        if (rights & (1 << right)) {
+            *p++ = "KQkq"[right];
+        }
+    }
+    *p++ = ' ';
+    position target = enPassantTarget();
+    if (target == position()) {
+        *p++ = '-';
+    } else {
+        *p++ = static_cast<char>('a' + target.file - 1);
+        *p++ = static_cast<char>('0' + target.rank);
+    }
+    for (int counter: {int(_halfmoveClock), int(_fullmove)}) {
+        *p++ = ' ';
+        p = std::to_chars(p, out + max_fen_length, counter).ptr;
+    }
+    *p = '\0';
+    return static_cast<int>(p - out);
 }
@@ -1,28 +1,54 @@
 
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
 
+struct stats_snapshot;
+
+// Set of squares, one bit per square. Bit 0 is a1, bit 7 is h1 and bit 63 is h8.
+using bitboard = std::uint64_t;
+
+constexpr bitboard squareBit(int square) { return bitboard(1) << square; }
+
+// Removes the lowest square from the set and returns it.
+constexpr int popSquare(bitboard& set) {
+    int square = std::countr_zero(set);
+    set &= set - 1;
+    return square;
+}
+
 
 // Difference of two positions. Behaves similarly to a vector in affine space.
 struct move {
     int file;
     int rank;
 
-    bool isDiagonal();
+    constexpr bool isDiagonal() const { return abs(*this).file == abs(*this).rank; }
 
-    bool isStraight();
+    constexpr bool isStraight() const { return file == 0 || rank == 0; }
 
-    void directionize();
+    // Shortens the move to a single step in the same direction.
+    constexpr void directionize() {
+        file = (file > 0) - (file < 0);
+        rank = (rank > 0) - (rank < 0);
+    }
 
-    bool operator==(move other);
+    constexpr bool operator==(move other) const { return rank == other.rank && file == other.file; }
 
-    bool operator!=(move other);
+    constexpr bool operator!=(move other) const { return !(*this == other); }
 
-    static move abs(move move);
+    static constexpr move abs(move m) { return {m.file < 0 ? -m.file : m.file, m.rank < 0 ? -m.rank : m.rank}; }
 
-    static move vert(int offset);
+    static constexpr move vert(int offset) { return {0, offset}; }
 
-    static move horiz(int offset);
+    static constexpr move horiz(int offset) { return {offset, 0}; }
 };
 
 // Positions on the chess board. Behaves similarly to a point in affine space.
@@ -30,23 +56,46 @@ struct position {
     int file = 0;
     int rank = 0;
 
-    // Returns all possible positions on the board.
+    // Returns all possible positions on the board, ordered by ‹index›.
+    static constexpr const std::array<position, 64>& allPositions();
 
-    static std::vector<position> allPositions();
+    constexpr bool operator==(position other) const { return rank == other.rank && file == other.file; }
 
-    bool operator==(position other);
+    constexpr bool operator!=(position other) const { return !(*this == other); }
 
-    bool operator!=(position other);
-
-    move operator-(position other);
+    constexpr move operator-(position other) const { return {file - other.file, rank - other.rank}; }
 
     // If result falls out of the board returns {0, 0}.
-    position operator+(move other);
+    constexpr position operator+(move other) const {
+        position result = {file + other.file, rank + other.rank};
+        if (result.rank < 1 || result.rank > 8 || result.file < 1 || result.file > 8) {
+            return position();
+        }
+        return result;
+    }
+
+    // Index of the square in a ‹bitboard›.
+    constexpr int index() const { return (rank - 1) * 8 + file - 1; }
+
+    static constexpr position fromIndex(int index) { return {index % 8 + 1, index / 8 + 1}; }
 };
 
-enum class piece_type { pawn, rook, knight, bishop, queen, king };
+inline constexpr std::array<position, 64> all_positions = []() {
+    std::array<position, 64> positions;
+    for (int i = 0; i < 64; ++i) {
+        positions[i] = position::fromIndex(i);
+    }
+    return positions;
+}();
+
+constexpr const std::array<position, 64>& position::allPositions() { return all_positions; }
+
+enum class piece_type : std::uint8_t { pawn, rook, knight, bishop, queen, king };
 
-enum class player { white, black };
+enum class player : std::uint8_t { white, black };
+
+// Squares attacked by a piece of ‹owner› on ‹square› when the ‹occupied› squares block the rays.
+bitboard pieceAttacks(piece_type type, player owner, int square, bitboard occupied);
 
 /* The following are the possible outcomes of ‹play›. The outcomes
  * are shown in the order of precedence, i.e. the first applicable
@@ -102,12 +151,236 @@ struct occupant {
 
 };
 
+// A move of the piece on ‹from› to ‹to›, both given as square indices.
+struct ply {
+    std::uint8_t from = 0;
+    std::uint8_t to = 0;
+    // Piece the pawn turns into, ‹piece_type::pawn› if the move is not a promotion.
+    piece_type promote = piece_type::pawn;
+
+    ply() = default;
+
+    ply(int from, int to, piece_type promote = piece_type::pawn)
+        :   from(static_cast<std::uint8_t>(from)),
+            to(static_cast<std::uint8_t>(to)),
+            promote(promote) {}
+
+    ply(position from, position to, piece_type promote = piece_type::pawn)
+        :   ply(from.index(), to.index(), promote) {}
+
+    position origin() const { return position::fromIndex(from); }
+
+    position target() const { return position::fromIndex(to); }
+
+    // Coordinate notation, e.g. "e2e4" or "e7e8q".
+    std::string toString() const;
+
+    // Returns false if ‹text› is not in coordinate notation.
+    static bool fromString(std::string_view text, ply& out);
+
+    bool operator==(const ply& other) const = default;
+};
+
+// Fixed-capacity list of moves filled by the move generator. No position has more
+// than 218 legal moves.
+struct ply_list {
+    static constexpr int capacity = 256;
+
+    ply moves[capacity];
+    int size = 0;
+
+    void push(ply p) { moves[size++] = p; }
+
+    bool contains(ply p) const;
+
+    ply* begin() { return moves; }
+
+    ply* end() { return moves + size; }
+
+    const ply* begin() const { return moves; }
+
+    const ply* end() const { return moves + size; }
+};
+
+// Moves wanted from ‹chess::generateLegalMoves›. The «noisy» moves are captures, «en passant»
+// included, and promotions; the quiet moves are all the others.
+enum class move_filter : std::uint8_t { all, noisy, quiet };
+
+// Everything ‹chess::makeMove› changes that cannot be read back from the board afterwards.
+struct undo_record {
+    ply move;
+    // Type of the captured piece, valid when the ‹captured› flag is set.
+    piece_type captured = piece_type::pawn;
+    // Bits of ‹undo_record::flag›.
+    std::uint8_t flags = 0;
+    // Counters of ‹chess› before the move.
+    std::uint8_t reversible = 0;
+    std::uint16_t halfmoveClock = 0;
+    // The ‹occupant::canBeLapsed› squares before the move.
+    bitboard lapsable = 0;
+    // ‹chess::key› of the position before the move, to find repetitions.
+    std::uint64_t key = 0;
+
+    enum flag : std::uint8_t {
+        mover_moved = 1, mover_two_step = 2, captured_moved = 4, captured_two_step = 8,
+        capture = 16, en_passant = 32, castling = 64, null_move = 128
+    };
+};
+
+/* The most recent ‹undo_record›s of the moves made on a board, kept apart from
+ * the board so that copying a board does not copy its past. Moves older than
+ * ‹size› plies are forgotten, which does not matter to ‹chess::repetitions› as
+ * long as it stays above the 100 plies of the fifty-move rule. */
+class move_history {
+public:
+    static constexpr int size = 128;
+
+private:
+    undo_record _records[size];
+    // All moves recorded, the last ‹_count› of them are kept.
+    int _plies = 0;
+    int _count = 0;
+
+public:
+    // Record for the next move.
+    undo_record& push() {
+        undo_record& record = _records[_plies % size];
+        ++_plies;
+        _count = std::min(_count + 1, size);
+        return record;
+    }
+
+    // Forgets the last move and returns its record. There has to be one.
+    const undo_record& pop() {
+        --_plies;
+        --_count;
+        return _records[_plies % size];
+    }
+
+    int count() const { return _count; }
+
+    // Record of the move ‹back› plies ago, 1 being the last move. ‹back› is at most ‹count›.
+    const undo_record& last(int back = 1) const { return _records[(_plies - back) % size]; }
+
+    void clear() {
+        _plies = 0;
+        _count = 0;
+    }
+};
+
+// State of a game as seen from its current position, see ‹chess::status›.
+enum class game_status : std::uint8_t {
+    ongoing, checkmate, stalemate, repetition, fifty_moves, insufficient_material
+};
+
+// Legality of every move of the player to move, filled by ‹chess::classifyMoves›.
+struct move_table {
+    // What ‹chess::validate› says of the move from the first square index to the second.
+    result results[64][64];
+    // Targets of the legal moves from every square.
+    bitboard targets[64];
+
+    result at(position from, position to) const { return results[from.index()][to.index()]; }
+};
+
+// Checks on the king of the player to move, see ‹chess::checkState›.
+struct check_state {
+    // Pieces giving check.
+    bitboard checkers = 0;
+    // Squares a piece other than the king has to move to: anywhere when not in check, the
+    // checker or a square between it and the king in a single check, none in a double check.
+    bitboard evasions = ~bitboard(0);
+    // Own pieces that may only move along the line through them and the king.
+    bitboard pinned = 0;
+    // Squares attacked by the opponent as if the king were not on the board.
+    bitboard kingDanger = 0;
+};
+
 class chess {
+public:
+    enum castling : std::uint8_t {
+        white_king_side = 1, white_queen_side = 2, black_king_side = 4, black_queen_side = 8
+    };
 
+private:
     player _player;
 
-    std::vector<std::vector<occupant>> _occupants;
+    // Squares occupied by each piece type (indexed by ‹piece_type›) and by each player.
+    bitboard _pieces[6] {};
+    bitboard _colours[2] {};
+    bitboard _occupied {};
+
+    // Squares whose occupant has the corresponding ‹occupant› flag set.
+    bitboard _moved {};
+    bitboard _twoStep {};
+    bitboard _lapsable {};
+
+    // Square of each player's king, ‹no_square› if there is none.
+    std::uint8_t _kings[2] {no_square, no_square};
+
+    // Squares attacked by each player. Recomputed after every move, changes made in between
+    // mark them stale and attack queries scan from the square instead.
+    bitboard _attacks[2] {};
+    bool _attacksStale {true};
+
+    // Zobrist key of the pieces and of the player to move, see ‹key›.
+    std::uint64_t _key {0};
+
+    // Plies since the last capture or pawn move, and the number of the current move, starting
+    // at 1 and counted up after every move of black.
+    std::uint16_t _halfmoveClock {0};
+    std::uint16_t _fullmove {1};
+    // Plies since the last move after which no earlier position can come back: a capture, a pawn
+    // move, a move that takes a castling right away, or a null move. Bounds the search for
+    // repetitions, so it stops counting at the size of ‹move_history›.
+    std::uint8_t _reversible {0};
+
+    // Sums of ‹psqtValue› over all pieces, see ‹eval.hpp›.
+    int _middlegame {0};
+    int _endgame {0};
+
+    // ‹makeMove› without updating the attack maps.
+    void applyMove(ply p, undo_record& record);
+
+    void updateAttacks();
+
+    // Squares attacked by ‹by› computed from the pieces on the board, with the squares of
+    // ‹occupied› blocking the sliding pieces.
+    bitboard computeAttacks(player by, bitboard occupied) const;
+
+    // Type of the piece on an occupied square.
+    piece_type pieceAt(int square) const;
+
+    void clearSquare(int square);
+
+    // Adds the piece-square values of a piece to the sums, or takes them away when ‹sign› is -1.
+    void addPsqt(player owner, piece_type piece, int square, int sign);
+
+    // Same as ‹isAttacked› but always looks at the board around the square.
+    bool scanAttacked(int square, player by) const;
+
+    // Pieces of ‹by› attacking the square.
+    bitboard attackersOf(int square, player by) const;
+
+    // Computes the checks of the current position from scratch.
+    check_state checkState() const;
+
+    // Whether a move the pieces can make leaves the king of the player in check, decided with
+    // ‹checks› instead of a trial move except for an «en passant».
+    bool wouldCheck(position from, position to, const check_state& checks);
+
+    // ‹validate› with the checks of the position known.
+    result checkMove(position from, position to, bool wasChecked, const check_state& checks);
+
+    bool wouldCheckCastling(position from, position to, const check_state& checks) const;
+
+    // ‹play› that fills ‹record› when the move is made.
+    result playMove(position from, position to, piece_type promote, undo_record& record);
+
+    // Squares a piece of ‹type› on ‹from› may try to reach. The rules are checked by ‹validate›.
+    bitboard candidateTargets(position from, piece_type type);
 public:
+    static constexpr std::uint8_t no_square = 64;
 
     chess();
 
@@ -130,12 +403,45 @@ public:
 
     bool isChecked();
 
+    // Squares attacked by the pieces of ‹by›, including those occupied by its own pieces.
+    bitboard attacks(player by);
+
+    bool isAttacked(position at, player by) const;
+
     // Checks only straight moves, diagonal moves or castling.
     bool isBlocked(position from, position to, player player);
 
     void makeMove(position from, position to);
 
-    occupant& getOccupant(position at);
+    // Performs a legal move of the current player, filling ‹record› to take it back with.
+    void makeMove(ply p, undo_record& record);
+
+    void makeMove(ply p, move_history& history) { makeMove(p, history.push()); }
+
+    // A move that will not be taken back.
+    void makeMove(ply p) {
+        undo_record record;
+        makeMove(p, record);
+    }
+
+    // Takes back the move ‹record› was filled by, which has to be the last move made.
+    void unmakeMove(const undo_record& record);
+
+    void unmakeMove(move_history& history) { unmakeMove(history.pop()); }
+
+    // Takes back the last move of ‹history›, returns false if there is none to take back.
+    bool undo(move_history& history);
+
+    // Passes the turn without moving, as used by null-move pruning. Taken back by ‹unmakeMove›.
+    void makeNullMove(undo_record& record);
+
+    void makeNullMove(move_history& history) { makeNullMove(history.push()); }
+
+    // Does not look at the legality of the move.
+    bool isCapture(ply p) const;
+
+    // Unlike ‹at› the position has to be on the board.
+    occupant getOccupant(position at) const;
 
     void placeOccupant(occupant occupant, position at);
 
@@ -145,8 +451,26 @@ public:
     // Returns position of the king of the current player.
     position findKingPosition();
 
-    player getOpponent();
+    // Returns position of the king of ‹owner› or {0, 0} if there is none.
+    position kingPosition(player owner) const;
+
+    player getOpponent() const;
 
+    player getPlayer() const { return _player; }
+
+    bitboard pieces(player owner, piece_type type) const {
+        return _colours[static_cast<int>(owner)] & _pieces[static_cast<int>(type)];
+    }
+
+    bitboard pieces(player owner) const { return _colours[static_cast<int>(owner)]; }
+
+    // Piece-square sums of the middlegame and the endgame, positive when good for white.
+    int middlegameScore() const { return _middlegame; }
+
+    int endgameScore() const { return _endgame; }
+
+    // Plays the move, looks for a check and takes the move back. The rules only need it for an
+    // «en passant» that may uncover the king, see ‹checkState›.
     bool wouldCheck(position from, position to);
 
     // Sets canBeLapsed to false for all pawns of the current player.
@@ -175,8 +499,86 @@ public:
 
     void applyPromote(position at, piece_type promote);
 
+    // Checks the move of the current player without performing it. Returns ‹result::ok›
+    // for a legal move, captures and promotions are not told apart.
+    result validate(position from, position to, bool wasChecked);
+
     result play(position from, position to, piece_type promote = piece_type::pawn);
 
+    // ‹play› that records the move in ‹history›, to be taken back by ‹undo›.
+    result play(position from, position to, piece_type promote, move_history& history);
+
+    /* Fills ‹out› with the ‹validate› result of every pair of squares, sharing the
+     * work on checks and pins among all of them, which makes it much faster than
+     * one ‹validate› for each pair. Promotions are not told apart, see ‹play›. */
+    void classifyMoves(move_table& out);
+
+    // Writes the legal moves of the current player that pass ‹filter› into ‹list›. The other
+    // moves are not looked at.
+    void generateLegalMoves(ply_list& list, move_filter filter = move_filter::all);
+
+    // Checks a move that may come from another position, e.g. a hash move.
+    bool isLegal(ply p);
+
+    // Whether the current player can move at all, stops at the first legal move found.
+    bool hasLegalMove();
+
+    /* Number of times the current position has occurred before, with the same
+     * player to move, castling rights and «en passant» captures, going back through
+     * the moves of ‹history›, which has to hold the moves that led to the position.
+     * Only the positions since the last capture, pawn move or change of castling
+     * rights are looked at. */
+    int repetitions(const move_history& history) const;
+
+    // Neither player has the pieces to ever give mate: bare kings, a single minor piece, or
+    // bishops only, all on squares of one colour.
+    bool isInsufficientMaterial() const;
+
+    // Plies since the last capture or pawn move.
+    int halfmoveClock() const { return _halfmoveClock; }
+
+    int fullmoveNumber() const { return _fullmove; }
+
+    /* Whether the game is over, and why. A position without a legal move is a
+     * checkmate or a stalemate, otherwise it is a draw by insufficient material, by
+     * the fifty-move rule (100 plies without a capture or a pawn move) or by a
+     * threefold repetition, in that order, the repetitions found in ‹history›. The
+     * last two are draws a player may claim. */
+    game_status status(const move_history& history);
+
+    // Number of leaf nodes of the move tree ‹depth› plies deep.
+    std::uint64_t perft(int depth);
+
+    // Counters of all threads so far, see ‹stats.hpp›.
+    static stats_snapshot stats();
+
+    // Zobrist key of the position: pieces, player to move, castling rights and the file of an
+    // «en passant» capture if one is possible.
+    std::uint64_t key() const;
+
+    // Bits of ‹castling› that are still available, derived from ‹occupant::didMove› of the kings
+    // and rooks on their initial squares.
+    std::uint8_t castlingRights() const;
+
+    // Square an «en passant» capture of the current player would land on, {0, 0} if there is none.
+    // The capture itself need not be possible.
+    position enPassantTarget() const;
+
+    // Longest text written by ‹toFEN›, including the terminating null.
+    static constexpr int max_fen_length = 100;
+
+    /* Sets up the position given in Forsyth–Edwards notation. Castling rights clear
+     * ‹occupant::didMove› of the king and the rook (every other king and rook counts
+     * as moved, as do pawns off their initial rank) and the «en passant» target sets
+     * ‹didTwoStep› and ‹canBeLapsed› of the pawn that has just moved. The move counters
+     * may be left out, they default to "0 1". Returns false and leaves the board as it was
+     * if the text is not a FEN of a position with one king of each player. */
+    bool fromFEN(std::string_view fen);
+
+    // Writes the position as a null-terminated FEN into ‹out›, which has to have room for
+    // ‹max_fen_length› characters, and returns its length.
+    int toFEN(char* out) const;
+
     // For position {0, 0} returns new default occupant.
     occupant at(position) const;
 
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/* The counters of ‹stats.hpp› as the hot paths see them: only what counting and
+ * timing need, without the snapshots and the reporting thread. */
+
+#ifdef CHESS_STATS
+constexpr bool stats_enabled = true;
+#else
+constexpr bool stats_enabled = false;
+#endif
+
+enum class counter {
+    play,
+    is_checked,
+    would_check,
+    is_blocked,
+    generate,
+    // Moves found by ‹generate›.
+    generated_moves,
+    search,
+    nodes,
+    quiescence_nodes,
+    beta_cutoffs,
+    table_probes,
+    table_hits,
+    tablebase_hits,
+    count
+};
+
+constexpr int counter_count = static_cast<int>(counter::count);
+
+const char* counterName(counter s);
+
+void addStat(counter s, std::uint64_t count, std::uint64_t nanoseconds);
+
+inline void countStat(counter s, std::uint64_t count = 1) {
+    if constexpr (stats_enabled) {
+        addStat(s, count, 0);
+    }
+}
+
+// Counts a call to ‹s› and the time until the end of the scope.
+class stat_timer {
+    counter _stat;
+    std::chrono::steady_clock::time_point _start;
+
+public:
+    explicit stat_timer(counter s)
+        :   _stat(s) {
+        if constexpr (stats_enabled) {
+            _start = std::chrono::steady_clock::now();
+        }
+    }
+
+    stat_timer(const stat_timer&) = delete;
+
+    stat_timer& operator=(const stat_timer&) = delete;
+
+    ~stat_timer() {
+        if constexpr (stats_enabled) {
+            auto elapsed = std::chrono::steady_clock::now() - _start;
+            addStat(_stat, 1, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+};
@@ -0,0 +1,14 @@
+#include "eval.hpp"
+#include <algorithm>
+#include <bit>
+
+int evaluate(const chess& board) {
+    int phase = 0;
+    for (piece_type type: {piece_type::rook, piece_type::knight, piece_type::bishop, piece_type::queen}) {
+        bitboard both = board.pieces(player::white, type) | board.pieces(player::black, type);
+        phase += phase_weights[static_cast<int>(type)] * std::popcount(both);
+    }
+    phase = std::min(phase, max_phase);
+    int score = (board.middlegameScore() * phase + board.endgameScore() * (max_phase - phase)) / max_phase;
+    return board.getPlayer() == player::white ? score : -score;
+}
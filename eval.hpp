@@ -0,0 +1,129 @@
+#pragma once
+
+#include "chess.hpp"
+#include <cstdint>
+
+// Weight of every ‹piece_type› in the game phase, all pieces on the board make ‹max_phase›.
+constexpr int phase_weights[6] = {0, 2, 1, 1, 4, 0};
+constexpr int max_phase = 24;
+
+/* Piece-square tables in centipawns with the value of the piece included, one
+ * for the middlegame and one for the endgame. The layouts are drawn as seen by
+ * white, rank 8 at the top, and indexed by ‹piece_type›. */
+inline constexpr std::int16_t psqt_layout[2][6][64] = {{
+    {  0,   0,   0,   0,   0,   0,   0,   0,
+      50,  50,  50,  50,  50,  50,  50,  50,
+      15,  15,  20,  30,  30,  20,  15,  15,
+       5,   5,  10,  25,  25,  10,   5,   5,
+       0,   0,   5,  20,  20,   5,   0,   0,
+       5,  -5,  -5,   5,   5,  -5,  -5,   5,
+       5,  10,  10, -20, -20,  10,  10,   5,
+       0,   0,   0,   0,   0,   0,   0,   0},
+    {  0,   0,   0,   0,   0,   0,   0,   0,
+       5,  10,  10,  10,  10,  10,  10,   5,
+      -5,   0,   0,   0,   0,   0,   0,  -5,
+      -5,   0,   0,   0,   0,   0,   0,  -5,
+      -5,   0,   0,   0,   0,   0,   0,  -5,
+      -5,   0,   0,   0,   0,   0,   0,  -5,
+      -5,   0,   0,   0,   0,   0,   0,  -5,
+       0,   0,   0,   5,   5,   0,   0,   0},
+    {-50, -40, -30, -30, -30, -30, -40, -50,
+     -40, -20,   0,   5,   5,   0, -20, -40,
+     -30,   5,  10,  15,  15,  10,   5, -30,
+     -30,   0,  15,  20,  20,  15,   0, -30,
+     -30,   5,  15,  20,  20,  15,   5, -30,
+     -30,   0,  10,  15,  15,  10,   0, -30,
+     -40, -20,   0,   0,   0,   0, -20, -40,
+     -50, -40, -30, -30, -30, -30, -40, -50},
+    {-20, -10, -10, -10, -10, -10, -10, -20,
+     -10,   0,   0,   0,   0,   0,   0, -10,
+     -10,   0,   5,  10,  10,   5,   0, -10,
+     -10,   5,   5,  10,  10,   5,   5, -10,
+     -10,   0,  10,  10,  10,  10,   0, -10,
+     -10,  10,  10,  10,  10,  10,  10, -10,
+     -10,   5,   0,   0,   0,   0,   5, -10,
+     -20, -10, -10, -10, -10, -10, -10, -20},
+    {-20, -10, -10,  -5,  -5, -10, -10, -20,
+     -10,   0,   0,   0,   0,   0,   0, -10,
+     -10,   0,   5,   5,   5,   5,   0, -10,
+      -5,   0,   5,   5,   5,   5,   0,  -5,
+       0,   0,   5,   5,   5,   5,   0,  -5,
+     -10,   5,   5,   5,   5,   5,   0, -10,
+     -10,   0,   5,   0,   0,   0,   0, -10,
+     -20, -10, -10,  -5,  -5, -10, -10, -20},
+    {-30, -40, -40, -50, -50, -40, -40, -30,
+     -30, -40, -40, -50, -50, -40, -40, -30,
+     -30, -40, -40, -50, -50, -40, -40, -30,
+     -30, -40, -40, -50, -50, -40, -40, -30,
+     -20, -30, -30, -40, -40, -30, -30, -20,
+     -10, -20, -20, -20, -20, -20, -20, -10,
+      20,  20,   0,   0,   0,   0,  20,  20,
+      20,  30,  10,   0,   0,  10,  30,  20},
+}, {
+    {  0,   0,   0,   0,   0,   0,   0,   0,
+      80,  80,  80,  80,  80,  80,  80,  80,
+      50,  50,  45,  40,  40,  45,  50,  50,
+      30,  30,  25,  20,  20,  25,  30,  30,
+      15,  15,  10,  10,  10,  10,  15,  15,
+       5,   5,   5,   5,   5,   5,   5,   5,
+       0,   0,   0,   0,   0,   0,   0,   0,
+       0,   0,   0,   0,   0,   0,   0,   0},
+    { 10,  10,  10,  10,  10,  10,  10,  10,
+      15,  15,  15,  15,  15,  15,  15,  15,
+       5,   5,   5,   5,   5,   5,   5,   5,
+       0,   0,   0,   0,   0,   0,   0,   0,
+       0,   0,   0,   0,   0,   0,   0,   0,
+       0,   0,   0,   0,   0,   0,   0,   0,
+       0,   0,   0,   0,   0,   0,   0,   0,
+      -5,   0,   0,   0,   0,   0,   0,  -5},
+    {-40, -30, -20, -20, -20, -20, -30, -40,
+     -30, -15,  -5,   0,   0,  -5, -15, -30,
+     -20,  -5,  10,  15,  15,  10,  -5, -20,
+     -20,   0,  15,  20,  20,  15,   0, -20,
+     -20,   0,  15,  20,  20,  15,   0, -20,
+     -20,  -5,  10,  15,  15,  10,  -5, -20,
+     -30, -15,  -5,   0,   0,  -5, -15, -30,
+     -40, -30, -20, -20, -20, -20, -30, -40},
+    {-15, -10, -10, -10, -10, -10, -10, -15,
+     -10,  -5,   0,   0,   0,   0,  -5, -10,
+     -10,   0,   5,   5,   5,   5,   0, -10,
+     -10,   0,   5,  10,  10,   5,   0, -10,
+     -10,   0,   5,  10,  10,   5,   0, -10,
+     -10,   0,   5,   5,   5,   5,   0, -10,
+     -10,  -5,   0,   0,   0,   0,  -5, -10,
+     -15, -10, -10, -10, -10, -10, -10, -15},
+    {-20, -10, -10, -10, -10, -10, -10, -20,
+     -10,   0,   5,   5,   5,   5,   0, -10,
+     -10,   5,  10,  10,  10,  10,   5, -10,
+     -10,   5,  10,  15,  15,  10,   5, -10,
+     -10,   5,  10,  15,  15,  10,   5, -10,
+     -10,   5,  10,  10,  10,  10,   5, -10,
+     -10,   0,   5,   5,   5,   5,   0, -10,
+     -20, -10, -10, -10, -10, -10, -10, -20},
+    {-50, -40, -30, -20, -20, -30, -40, -50,
+     -30, -20, -10,   0,   0, -10, -20, -30,
+     -30, -10,  20,  30,  30,  20, -10, -30,
+     -30, -10,  30,  40,  40,  30, -10, -30,
+     -30, -10,  30,  40,  40,  30, -10, -30,
+     -30, -10,  20,  30,  30,  20, -10, -30,
+     -30, -30,   0,   0,   0,   0, -30, -30,
+     -50, -30, -30, -30, -30, -30, -30, -50},
+}};
+
+// Values of the pieces in the middlegame and in the endgame, indexed by ‹piece_type›.
+inline constexpr std::int16_t piece_value[2][6] = {{85, 480, 330, 350, 1000, 0}, {100, 520, 290, 310, 950, 0}};
+
+// Value of a piece of ‹owner› on ‹square› for white (negative for black) in the middlegame
+// (‹endgame› false) or in the endgame.
+constexpr int psqtValue(bool endgame, player owner, piece_type piece, int square) {
+    int type = static_cast<int>(piece);
+    if (owner == player::white) {
+        return piece_value[endgame][type] + psqt_layout[endgame][type][square ^ 56];
+    }
+    return -(piece_value[endgame][type] + psqt_layout[endgame][type][square]);
+}
+
+/* Static evaluation in centipawns from the point of view of the player to move:
+ * the piece-square sums kept by the board, blended from the middlegame to the
+ * endgame values as the pieces come off. */
+int evaluate(const chess& board);
@@ -0,0 +1,130 @@
+#include "gamehost.hpp"
+#include <algorithm>
+
+game_host::game_host(std::uint32_t capacity, int threads, reply_callback onReplies)
+    :   _games(new slot[capacity]), _capacity(capacity), _onReplies(std::move(onReplies)),
+        _workers(new worker[std::max(1, threads)]), _threads(std::max(1, threads)) {
+    _free.reserve(capacity);
+    for (std::uint32_t i = capacity; i > 0; --i) {
+        _free.push_back(i - 1);
+    }
+    for (int i = 0; i < _threads; ++i) {
+        worker& w = _workers[i];
+        w.thread = std::thread([this, &w]() { run(w); });
+    }
+}
+
+game_host::~game_host() {
+    for (int i = 0; i < _threads; ++i) {
+        worker& w = _workers[i];
+        {
+            std::lock_guard<std::mutex> lock(w.mutex);
+            w.quit = true;
+        }
+        w.wake.notify_one();
+    }
+    for (int i = 0; i < _threads; ++i) {
+        _workers[i].thread.join();
+    }
+}
+
+game_id game_host::create(std::string_view fen, create_error& error) {
+    chess board;
+    if (!fen.empty() && !board.fromFEN(fen)) {
+        error = create_error::bad_fen;
+        return no_game;
+    }
+    std::uint32_t index;
+    {
+        std::lock_guard<std::mutex> lock(_freeMutex);
+        if (_free.empty()) {
+            error = create_error::full;
+            return no_game;
+        }
+        index = _free.back();
+        _free.pop_back();
+    }
+    // No worker touches a free slot, and setting ‹playing› publishes it.
+    slot& game = _games[index];
+    game.board = board;
+    game.moves.clear();
+    game.playing = true;
+    error = create_error::none;
+    return index | game_id(game.generation) << 32;
+}
+
+void game_host::submit(const std::vector<game_request>& requests) {
+    for (int i = 0; i < _threads; ++i) {
+        worker& w = _workers[i];
+        bool added = false;
+        {
+            std::lock_guard<std::mutex> lock(w.mutex);
+            for (const game_request& request: requests) {
+                if (ownerOf(request.game) == i) {
+                    w.incoming.push_back(request);
+                    added = true;
+                }
+            }
+        }
+        if (added) {
+            w.wake.notify_one();
+        }
+    }
+}
+
+game_reply game_host::handle(const game_request& request) {
+    game_reply reply;
+    reply.request = request;
+    std::uint32_t index = slotOf(request.game);
+    // ‹playing› is read first: it publishes the generation set by ‹create›.
+    if (index >= _capacity || !_games[index].playing || _games[index].generation != request.game >> 32) {
+        return reply;
+    }
+    slot& game = _games[index];
+    reply.known = true;
+    reply.board = &game.board;
+    switch (request.type) {
+    case game_request::kind::move:
+        reply.outcome =
+            game.board.play(request.move.origin(), request.move.target(), request.move.promote, game.moves);
+        reply.status = game.board.status(game.moves);
+        break;
+    case game_request::kind::show:
+        reply.status = game.board.status(game.moves);
+        break;
+    case game_request::kind::end:
+        game.playing = false;
+        ++game.generation;
+        break;
+    }
+    return reply;
+}
+
+void game_host::run(worker& w) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(w.mutex);
+            w.wake.wait(lock, [&w]() { return !w.incoming.empty() || w.quit; });
+            if (w.incoming.empty()) {
+                return;
+            }
+            // The two buffers trade places and keep their capacity.
+            std::swap(w.incoming, w.working);
+        }
+        w.replies.clear();
+        w.ended.clear();
+        for (const game_request& request: w.working) {
+            w.replies.push_back(handle(request));
+            if (request.type == game_request::kind::end && w.replies.back().known) {
+                w.ended.push_back(slotOf(request.game));
+            }
+        }
+        w.working.clear();
+        _onReplies(w.replies);
+        // The boards of the ended games are shown to the callback, so they are freed after it.
+        if (!w.ended.empty()) {
+            std::lock_guard<std::mutex> lock(_freeMutex);
+            _free.insert(_free.end(), w.ended.begin(), w.ended.end());
+        }
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "chess.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* A game of a ‹game_host›: the slot of its board in the low 32 bits and above
+ * them how many games have ended in the slot before, so the number of an ended
+ * game does not reach the next game of its slot. */
+using game_id = std::uint64_t;
+
+constexpr game_id no_game = ~game_id(0);
+
+// Why ‹game_host::create› did not start a game.
+enum class create_error : std::uint8_t { none, full, bad_fen };
+
+// Something to do to a game of a ‹game_host›.
+struct game_request {
+    enum class kind : std::uint8_t { move, show, end };
+
+    kind type = kind::move;
+    game_id game = no_game;
+    // The move to play, for ‹kind::move›.
+    ply move;
+};
+
+// Answer to a ‹game_request›.
+struct game_reply {
+    game_request request;
+    // Whether the game was being played; the rest is left as it is when not.
+    bool known = false;
+    // What ‹chess::play› said of the move.
+    result outcome = result::ok;
+    // Status after the move.
+    game_status status = game_status::ongoing;
+    // The board of the game, valid during the callback only.
+    const chess* board = nullptr;
+};
+
+/* Plays thousands of games side by side. The boards are allocated once, in an
+ * array of ‹capacity› slots, and a game takes a free slot until it ends, so the
+ * memory does not grow with the number of games played. Every game belongs to
+ * one of the ‹threads› workers, by its number; the requests for a game are
+ * handled by its worker in the order they were submitted, those of different
+ * workers run in parallel.
+ *
+ * The replies come in batches to the callback, from the worker threads but for
+ * a given game always from the same one. ‹create› and ‹submit› are not to be
+ * called from the callback. The destructor waits for the submitted requests. */
+class game_host {
+public:
+    using reply_callback = std::function<void(const std::vector<game_reply>&)>;
+
+private:
+    struct slot {
+        chess board;
+        // Enough of the game to find its repetitions.
+        move_history moves;
+        // Games ended in the slot so far, the high half of the ‹game_id›. Changed by the worker
+        // of the slot before it is freed.
+        std::uint32_t generation = 0;
+        // Set by ‹create›, cleared by the worker of the game when it ends.
+        std::atomic<bool> playing {false};
+    };
+
+    struct worker {
+        std::mutex mutex;
+        std::condition_variable wake;
+        // Guarded by ‹mutex›.
+        std::vector<game_request> incoming;
+        bool quit = false;
+
+        std::vector<game_request> working;
+        std::vector<game_reply> replies;
+        std::vector<std::uint32_t> ended;
+        std::thread thread;
+    };
+
+    std::unique_ptr<slot[]> _games;
+    std::uint32_t _capacity;
+    reply_callback _onReplies;
+
+    std::mutex _freeMutex;
+    // Slots without a game, the most recently freed last.
+    std::vector<std::uint32_t> _free;
+
+    std::unique_ptr<worker[]> _workers;
+    int _threads;
+
+    static std::uint32_t slotOf(game_id game) { return static_cast<std::uint32_t>(game); }
+
+    // Worker of a game, the first one for the slots past the capacity.
+    int ownerOf(game_id game) const {
+        return slotOf(game) < _capacity ? static_cast<int>(slotOf(game) % _threads) : 0;
+    }
+
+    void run(worker& w);
+
+    game_reply handle(const game_request& request);
+
+public:
+    game_host(std::uint32_t capacity, int threads, reply_callback onReplies);
+
+    game_host(const game_host&) = delete;
+
+    game_host& operator=(const game_host&) = delete;
+
+    ~game_host();
+
+    // Starts a game from ‹fen›, the initial position if empty. Returns ‹no_game› if the FEN is
+    // not valid or every slot is taken, and says which in ‹error›.
+    game_id create(std::string_view fen, create_error& error);
+
+    game_id create(std::string_view fen = {}) {
+        create_error error;
+        return create(fen, error);
+    }
+
+    // Hands the requests to the workers of their games, taking one lock per worker.
+    void submit(const std::vector<game_request>& requests);
+
+    std::uint32_t capacity() const { return _capacity; }
+
+    int threads() const { return _threads; }
+};
@@ -0,0 +1,120 @@
+#include "movepick.hpp"
+#include <utility>
+
+move_picker::move_picker(chess& board, ply hashMove, const ply* killers, const int (*history)[64])
+    :   _board(board), _hashMove(hashMove), _killers(killers), _history(history), _noisyOnly(false) {}
+
+move_picker move_picker::noisyOnly(chess& board) {
+    move_picker picker(board, ply(), nullptr, nullptr);
+    picker._noisyOnly = true;
+    return picker;
+}
+
+// Rank of an attacker among those taking the same victim, the king last.
+static int attackerRank(piece_type piece) {
+    if (piece == piece_type::king) {
+        return capture_values[static_cast<int>(piece_type::queen)] / 16 + 1;
+    }
+    return capture_values[static_cast<int>(piece)] / 16;
+}
+
+void move_picker::scoreNoisy() {
+    for (int i = 0; i < _list.size; ++i) {
+        ply p = _list.moves[i];
+        occupant victim = _board.at(p.target());
+        int gain = 0;
+        if (!victim.is_empty) {
+            gain = capture_values[static_cast<int>(victim.piece)];
+        } else if (_board.isCapture(p)) {
+            gain = capture_values[static_cast<int>(piece_type::pawn)];
+        }
+        if (p.promote == piece_type::queen) {
+            gain += capture_values[static_cast<int>(piece_type::queen)];
+        }
+        // The ranks stay below the gap of 10 × 16 between the closest victims.
+        _scores[i] = 16 * gain - attackerRank(_board.at(p.origin()).piece);
+        if (p.promote != piece_type::pawn && p.promote != piece_type::queen) {
+            _scores[i] -= 1 << 16;
+        }
+    }
+}
+
+void move_picker::scoreQuiet() {
+    for (int i = 0; i < _list.size; ++i) {
+        _scores[i] = _history ? _history[_list.moves[i].from][_list.moves[i].to] : 0;
+    }
+}
+
+ply move_picker::pick() {
+    int best = _next;
+    for (int j = _next + 1; j < _list.size; ++j) {
+        if (_scores[j] > _scores[best]) {
+            best = j;
+        }
+    }
+    std::swap(_list.moves[_next], _list.moves[best]);
+    std::swap(_scores[_next], _scores[best]);
+    return _list.moves[_next++];
+}
+
+bool move_picker::isSpecial(ply p) const {
+    return p == _hashMove || (_killers && (p == _killers[0] || p == _killers[1]));
+}
+
+bool move_picker::next(ply& out) {
+    for (;;) {
+        switch (_stage) {
+            case hash:
+                // ‹_next› tells whether the hash move was looked at already.
+                if (_next == 0) {
+                    _next = 1;
+                    if (_hashMove != ply() && _board.isLegal(_hashMove)) {
+                        out = _hashMove;
+                        return true;
+                    }
+                }
+                _board.generateLegalMoves(_list, move_filter::noisy);
+                scoreNoisy();
+                _next = 0;
+                _stage = noisy;
+                break;
+            case noisy:
+                while (_next < _list.size) {
+                    ply p = pick();
+                    if (p != _hashMove) {
+                        out = p;
+                        return true;
+                    }
+                }
+                _next = 0;
+                _stage = _noisyOnly ? done : killers;
+                break;
+            case killers:
+                while (_killers && _next < 2) {
+                    ply p = _killers[_next++];
+                    if (p != ply() && p != _hashMove && (_next == 1 || p != _killers[0]) &&
+                        !_board.isCapture(p) && p.promote == piece_type::pawn && _board.isLegal(p)) {
+                        out = p;
+                        return true;
+                    }
+                }
+                _board.generateLegalMoves(_list, move_filter::quiet);
+                scoreQuiet();
+                _next = 0;
+                _stage = quiet;
+                break;
+            case quiet:
+                while (_next < _list.size) {
+                    ply p = pick();
+                    if (!isSpecial(p)) {
+                        out = p;
+                        return true;
+                    }
+                }
+                _stage = done;
+                break;
+            case done:
+                return false;
+        }
+    }
+}
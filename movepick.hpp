@@ -0,0 +1,59 @@
+#pragma once
+
+#include "chess.hpp"
+
+// Values of the pieces for ordering the captures, indexed by ‹piece_type›.
+constexpr int capture_values[6] = {100, 500, 320, 330, 900, 0};
+
+/* Hands out the legal moves of a position one at a time, best first, and
+ * generates each group only when the previous one is used up:
+ *
+ * ├┄┄┄┄┄┄┄┄┄┄┄┄┄┄┼┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┤
+ * │ ‹hash›       │ the move from the transposition table, if it is legal  │
+ * │ ‹noisy›      │ captures and promotions, most valuable victim first,   │
+ * │              │ then least valuable attacker; underpromotions last     │
+ * │ ‹killers›    │ the two killer moves, if they are legal and quiet      │
+ * │ ‹quiet›      │ the other moves by their history score                 │
+ *
+ * A cutoff after the first few moves thus never pays for the quiet moves. In
+ * the ‹noisy_only› mode the picker stops after the noisy moves. Every move is
+ * handed out once. The board must not change between calls to ‹next›, except
+ * for moves that are taken back before the next call. */
+class move_picker {
+public:
+    enum stage : std::uint8_t { hash, noisy, killers, quiet, done };
+
+private:
+    chess& _board;
+    ply _hashMove;
+    const ply* _killers;
+    const int (*_history)[64];
+    bool _noisyOnly;
+    stage _stage = hash;
+    ply_list _list;
+    int _scores[ply_list::capacity];
+    int _next = 0;
+
+    void scoreNoisy();
+
+    void scoreQuiet();
+
+    // Takes the best of the remaining moves of the list.
+    ply pick();
+
+    bool isSpecial(ply p) const;
+
+public:
+    // Picks all moves. ‹killers› points to two moves and ‹history› is indexed by the origin and
+    // target squares of a move, both may be null.
+    move_picker(chess& board, ply hashMove, const ply* killers, const int (*history)[64]);
+
+    // Picks only the noisy moves, for the quiescence search or to list the threats.
+    static move_picker noisyOnly(chess& board);
+
+    // Stores the next move into ‹out›, returns false when there is none left.
+    bool next(ply& out);
+
+    // Stage of the move last handed out.
+    stage current() const { return _stage; }
+};
@@ -0,0 +1,181 @@
+#include "nnue.hpp"
+#include <bit>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+static_assert(std::endian::native == std::endian::little, "the weights are read in place");
+static_assert(nnue_hidden % 16 == 0, "the kernels work on whole vectors");
+
+// Input of a piece as seen by ‹perspective›: its own pieces first, the board flipped for black.
+static int featureIndex(player perspective, player owner, piece_type piece, int square) {
+    if (perspective == player::black) {
+        square ^= 56;
+    }
+    return (owner == perspective ? 0 : 384) + static_cast<int>(piece) * 64 + square;
+}
+
+/* The kernels. Every one has an AVX2 and an SSE2 version, used when the compiler
+ * targets them, and a plain one; all give the same numbers. The sums of 16 bit
+ * values wrap around like the plain ones would. */
+
+static void addRow(std::int16_t* values, const std::int16_t* row) {
+#if defined(__AVX2__)
+    for (int i = 0; i < nnue_hidden; i += 16) {
+        __m256i* v = reinterpret_cast<__m256i*>(values + i);
+        *v = _mm256_add_epi16(*v, _mm256_load_si256(reinterpret_cast<const __m256i*>(row + i)));
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < nnue_hidden; i += 8) {
+        __m128i* v = reinterpret_cast<__m128i*>(values + i);
+        *v = _mm_add_epi16(*v, _mm_load_si128(reinterpret_cast<const __m128i*>(row + i)));
+    }
+#else
+    for (int i = 0; i < nnue_hidden; ++i) {
+        values[i] = static_cast<std::int16_t>(values[i] + row[i]);
+    }
+#endif
+}
+
+static void subtractRow(std::int16_t* values, const std::int16_t* row) {
+#if defined(__AVX2__)
+    for (int i = 0; i < nnue_hidden; i += 16) {
+        __m256i* v = reinterpret_cast<__m256i*>(values + i);
+        *v = _mm256_sub_epi16(*v, _mm256_load_si256(reinterpret_cast<const __m256i*>(row + i)));
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < nnue_hidden; i += 8) {
+        __m128i* v = reinterpret_cast<__m128i*>(values + i);
+        *v = _mm_sub_epi16(*v, _mm_load_si128(reinterpret_cast<const __m128i*>(row + i)));
+    }
+#else
+    for (int i = 0; i < nnue_hidden; ++i) {
+        values[i] = static_cast<std::int16_t>(values[i] - row[i]);
+    }
+#endif
+}
+
+// Sum of the hidden values clipped to [0, ‹nnue_scale_hidden›] times the weights.
+static int clippedDot(const std::int16_t* values, const std::int16_t* weights) {
+#if defined(__AVX2__)
+    const __m256i low = _mm256_setzero_si256();
+    const __m256i high = _mm256_set1_epi16(nnue_scale_hidden);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < nnue_hidden; i += 16) {
+        __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(values + i));
+        v = _mm256_min_epi16(_mm256_max_epi16(v, low), high);
+        __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, w));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+    return _mm_cvtsi128_si32(half);
+#elif defined(__SSE2__)
+    const __m128i low = _mm_setzero_si128();
+    const __m128i high = _mm_set1_epi16(nnue_scale_hidden);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < nnue_hidden; i += 8) {
+        __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(values + i));
+        v = _mm_min_epi16(_mm_max_epi16(v, low), high);
+        __m128i w = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(v, w));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int sum = 0;
+    for (int i = 0; i < nnue_hidden; ++i) {
+        int v = values[i] < 0 ? 0 : values[i] > nnue_scale_hidden ? nnue_scale_hidden : values[i];
+        sum += v * weights[i];
+    }
+    return sum;
+#endif
+}
+
+bool network::load(const char* path) {
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[4];
+    std::uint32_t hidden = 0;
+    auto weights = std::make_unique<nnue_weights>();
+    bool good = std::fread(magic, sizeof(magic), 1, file) == 1 && std::memcmp(magic, "NNUE", 4) == 0 &&
+                std::fread(&hidden, sizeof(hidden), 1, file) == 1 && hidden == nnue_hidden &&
+                std::fread(weights->features, sizeof(weights->features), 1, file) == 1 &&
+                std::fread(weights->biases, sizeof(weights->biases), 1, file) == 1 &&
+                std::fread(weights->output, sizeof(weights->output), 1, file) == 1 &&
+                std::fread(&weights->outputBias, sizeof(weights->outputBias), 1, file) == 1 &&
+                std::fgetc(file) == EOF;
+    std::fclose(file);
+    if (good) {
+        _weights = std::move(weights);
+    }
+    return good;
+}
+
+void network::addPiece(nnue_accumulator& acc, player owner, piece_type piece, int square) const {
+    for (player perspective: {player::white, player::black}) {
+        int feature = featureIndex(perspective, owner, piece, square);
+        addRow(acc.values[static_cast<int>(perspective)], _weights->features[feature]);
+    }
+}
+
+void network::removePiece(nnue_accumulator& acc, player owner, piece_type piece, int square) const {
+    for (player perspective: {player::white, player::black}) {
+        int feature = featureIndex(perspective, owner, piece, square);
+        subtractRow(acc.values[static_cast<int>(perspective)], _weights->features[feature]);
+    }
+}
+
+void network::refresh(const chess& board, nnue_accumulator& acc) const {
+    std::memcpy(acc.values[0], _weights->biases, sizeof(_weights->biases));
+    std::memcpy(acc.values[1], _weights->biases, sizeof(_weights->biases));
+    for (player owner: {player::white, player::black}) {
+        for (int piece = 0; piece < 6; ++piece) {
+            bitboard set = board.pieces(owner, static_cast<piece_type>(piece));
+            while (set) {
+                addPiece(acc, owner, static_cast<piece_type>(piece), popSquare(set));
+            }
+        }
+    }
+}
+
+void network::update(const nnue_accumulator& before, const chess& board, const undo_record& last,
+                     nnue_accumulator& after) const {
+    after = before;
+    if (last.flags & undo_record::null_move) {
+        return;
+    }
+    ply p = last.move;
+    player mover = board.getPlayer() == player::white ? player::black : player::white;
+    player other = board.getPlayer();
+    piece_type piece = board.at(p.target()).piece;
+    removePiece(after, mover, p.promote != piece_type::pawn ? piece_type::pawn : piece, p.from);
+    addPiece(after, mover, piece, p.to);
+    if (last.flags & undo_record::capture) {
+        int taken = p.to;
+        if (last.flags & undo_record::en_passant) {
+            taken += mover == player::white ? -8 : 8;
+        }
+        removePiece(after, other, last.captured, taken);
+    }
+    if (last.flags & undo_record::castling) {
+        // The rook goes from the corner to the square the king passed.
+        bool kingSide = p.to > p.from;
+        removePiece(after, mover, piece_type::rook, kingSide ? p.to + 1 : p.to - 2);
+        addPiece(after, mover, piece_type::rook, kingSide ? p.to - 1 : p.to + 1);
+    }
+}
+
+int network::evaluate(const chess& board, const nnue_accumulator& acc) const {
+    int us = static_cast<int>(board.getPlayer());
+    int output = clippedDot(acc.values[us], _weights->output[0]) +
+                 clippedDot(acc.values[1 - us], _weights->output[1]);
+    return (output / nnue_scale_hidden + _weights->outputBias) * nnue_scale_eval / nnue_scale_output;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "chess.hpp"
+#include <cstdint>
+#include <memory>
+
+/* Small quantised evaluation network in the «NNUE» style: 768 inputs, one for
+ * every piece type of either colour on every square, feed a hidden layer of
+ * ‹nnue_hidden› neurons for each perspective, which is cheap to update when a
+ * move changes a few inputs. The two halves, the one of the player to move
+ * first, go through a clipped ReLU into a single output.
+ *
+ * The weights are loaded from a file:
+ *
+ * ├┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┼┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┤
+ * │ magic, hidden size │ "NNUE" and a 32 bit ‹nnue_hidden›            │
+ * │ feature weights    │ 768 rows of ‹nnue_hidden› 16 bit weights     │
+ * │ feature biases     │ ‹nnue_hidden› 16 bit biases                  │
+ * │ output weights     │ 2 × ‹nnue_hidden›, own half first            │
+ * │ output bias        │ one 16 bit number                            │
+ *
+ * All numbers are little endian. The hidden values are quantised by
+ * ‹nnue_scale_hidden›, which is also where they are clipped, the output weights
+ * and bias by ‹nnue_scale_output›, and an output of 1 is worth ‹nnue_scale_eval›
+ * centipawns. */
+
+constexpr int nnue_inputs = 768;
+constexpr int nnue_hidden = 256;
+constexpr int nnue_scale_hidden = 255;
+constexpr int nnue_scale_output = 64;
+constexpr int nnue_scale_eval = 400;
+
+// Hidden layer before the activation, from the point of view of white and of black.
+struct alignas(64) nnue_accumulator {
+    std::int16_t values[2][nnue_hidden];
+};
+
+struct alignas(64) nnue_weights {
+    std::int16_t features[nnue_inputs][nnue_hidden];
+    std::int16_t biases[nnue_hidden];
+    std::int16_t output[2][nnue_hidden];
+    std::int16_t outputBias;
+};
+
+class network {
+    std::unique_ptr<nnue_weights> _weights;
+
+    void addPiece(nnue_accumulator& acc, player owner, piece_type piece, int square) const;
+
+    void removePiece(nnue_accumulator& acc, player owner, piece_type piece, int square) const;
+
+public:
+    // Returns false and keeps the weights loaded before if the file is not a valid network.
+    bool load(const char* path);
+
+    bool loaded() const { return _weights != nullptr; }
+
+    // Computes the accumulator of the position from scratch.
+    void refresh(const chess& board, nnue_accumulator& acc) const;
+
+    // Computes the accumulator of ‹board› from the one of the position before its last move,
+    // whose record is ‹last›.
+    void update(const nnue_accumulator& before, const chess& board, const undo_record& last,
+                nnue_accumulator& after) const;
+
+    // Evaluation in centipawns from the point of view of the player to move.
+    int evaluate(const chess& board, const nnue_accumulator& acc) const;
+};
@@ -0,0 +1,232 @@
+/* Perft: counts the leaf nodes of the move tree to measure the speed and check the
+ * correctness of the move generator.
+ *
+ *   perft [-t threads] [-H hash_mb] [-D] [-f fen] depth [move ...]
+ *   perft check [depth]
+ *
+ * The position is the initial one, or the one given by ‹-f›, with the given moves
+ * (in coordinate notation) played on top of it. ‹-D› prints the count of every
+ * root move («divide»), ‹-t› splits the root moves among worker threads and ‹-H›
+ * memoises subtree counts in a hash table of the given size. ‹check› compares the
+ * counts of a few well-known positions against reference values up to ‹depth› (4
+ * by default) and fails on the first mismatch. */
+
+#include "chess.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+// Subtree counts shared by all threads. Every slot keeps the count and the key
+// xor-ed with it, so a slot torn by two racing writers fails the check on read.
+class perft_table {
+    struct slot {
+        std::atomic<std::uint64_t> check {0};
+        std::atomic<std::uint64_t> nodes {0};
+    };
+
+    std::unique_ptr<slot[]> _slots;
+    std::uint64_t _mask = 0;
+
+    static std::uint64_t slotKey(std::uint64_t key, int depth) {
+        return key ^ (0x9e3779b97f4a7c15 * static_cast<std::uint64_t>(depth));
+    }
+
+public:
+    explicit perft_table(std::size_t megabytes) {
+        std::size_t count = 1;
+        while (count * 2 * sizeof(slot) <= megabytes << 20) {
+            count *= 2;
+        }
+        _slots = std::make_unique<slot[]>(count);
+        _mask = count - 1;
+    }
+
+    bool probe(std::uint64_t positionKey, int depth, std::uint64_t& nodes) const {
+        std::uint64_t key = slotKey(positionKey, depth);
+        const slot& s = _slots[key & _mask];
+        std::uint64_t stored = s.nodes.load(std::memory_order_relaxed);
+        if ((s.check.load(std::memory_order_relaxed) ^ stored) != key) {
+            return false;
+        }
+        nodes = stored;
+        return true;
+    }
+
+    void store(std::uint64_t positionKey, int depth, std::uint64_t nodes) {
+        std::uint64_t key = slotKey(positionKey, depth);
+        slot& s = _slots[key & _mask];
+        s.nodes.store(nodes, std::memory_order_relaxed);
+        s.check.store(key ^ nodes, std::memory_order_relaxed);
+    }
+};
+
+static std::uint64_t count(chess& board, int depth, perft_table* table) {
+    if (depth <= 1 || !table) {
+        return board.perft(depth);
+    }
+    std::uint64_t key = board.key();
+    std::uint64_t nodes = 0;
+    if (table->probe(key, depth, nodes)) {
+        return nodes;
+    }
+    ply_list list;
+    board.generateLegalMoves(list);
+    undo_record record;
+    for (ply p: list) {
+        board.makeMove(p, record);
+        nodes += count(board, depth - 1, table);
+        board.unmakeMove(record);
+    }
+    table->store(key, depth, nodes);
+    return nodes;
+}
+
+struct perft_options {
+    const char* fen = nullptr;
+    int depth = 1;
+    int threads = 1;
+    std::size_t hash = 0;
+    bool divide = false;
+};
+
+// Counts the nodes below every root move, the root moves are taken by the workers
+// one at a time.
+static std::uint64_t run(chess& board, const perft_options& options) {
+    ply_list list;
+    board.generateLegalMoves(list);
+    if (options.depth <= 1) {
+        if (options.divide) {
+            for (ply p: list) {
+                std::cout << p.toString() << ": 1\n";
+            }
+        }
+        return board.perft(options.depth);
+    }
+    std::unique_ptr<perft_table> table;
+    if (options.hash > 0) {
+        table = std::make_unique<perft_table>(options.hash);
+    }
+    std::vector<std::uint64_t> counts(list.size);
+    std::atomic<int> next {0};
+    auto worker = [&]() {
+        for (int i = next++; i < list.size; i = next++) {
+            chess child = board;
+            child.makeMove(list.moves[i]);
+            counts[i] = count(child, options.depth - 1, table.get());
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < options.threads; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t: workers) {
+        t.join();
+    }
+    std::uint64_t nodes = 0;
+    for (int i = 0; i < list.size; ++i) {
+        if (options.divide) {
+            std::cout << list.moves[i].toString() << ": " << counts[i] << '\n';
+        }
+        nodes += counts[i];
+    }
+    return nodes;
+}
+
+static std::uint64_t timed(chess& board, const perft_options& options) {
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t nodes = run(board, options);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "depth " << options.depth << ": " << nodes << " nodes in " << elapsed.count() << " s ("
+              << static_cast<std::uint64_t>(nodes / std::max(elapsed.count(), 1e-9)) << " nodes/s)\n";
+    return nodes;
+}
+
+// Reference node counts, the first position is the initial one.
+static const struct {
+    const char* fen;
+    std::uint64_t counts[7];
+} references[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     {1, 20, 400, 8902, 197281, 4865609, 119060324}},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     {1, 48, 2039, 97862, 4085603, 193690690, 8031647685}},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     {1, 14, 191, 2812, 43238, 674624, 11030083}},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     {1, 6, 264, 9467, 422333, 15833292, 706045033}},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     {1, 44, 1486, 62379, 2103487, 89941194, 0}},
+};
+
+static int check(int depth, perft_options options) {
+    for (const auto& reference: references) {
+        std::cout << reference.fen << '\n';
+        for (options.depth = 1; options.depth <= depth && options.depth < 7; ++options.depth) {
+            if (!reference.counts[options.depth]) {
+                break;
+            }
+            chess board;
+            board.fromFEN(reference.fen);
+            std::uint64_t nodes = timed(board, options);
+            if (nodes != reference.counts[options.depth]) {
+                std::cout << "FAILED: expected " << reference.counts[options.depth] << '\n';
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int usage() {
+    std::cerr << "usage: perft [-t threads] [-H hash_mb] [-D] [-f fen] depth [move ...]\n"
+                 "       perft [-t threads] [-H hash_mb] check [depth]\n";
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    perft_options options;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (std::strcmp(argv[i], "-D") == 0) {
+            options.divide = true;
+        } else if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            options.threads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            options.hash = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            options.fen = argv[++i];
+        } else {
+            return usage();
+        }
+    }
+    if (i == argc) {
+        return usage();
+    }
+    if (std::strcmp(argv[i], "check") == 0) {
+        return check(i + 1 < argc ? std::atoi(argv[i + 1]) : 4, options);
+    }
+    options.depth = std::atoi(argv[i]);
+    chess board;
+    if (options.fen && !board.fromFEN(options.fen)) {
+        std::cerr << "invalid FEN: " << options.fen << '\n';
+        return 1;
+    }
+    for (++i; i < argc; ++i) {
+        ply p;
+        if (!ply::fromString(argv[i], p)) {
+            return usage();
+        }
+        result r = board.play(p.origin(), p.target(), p.promote);
+        if (r != result::ok && r != result::capture) {
+            std::cerr << "illegal move: " << argv[i] << '\n';
+            return 1;
+        }
+    }
+    timed(board, options);
+    return 0;
+}
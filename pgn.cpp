@@ -0,0 +1,380 @@
+#include "pgn.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+static bool isFile(char c) { return c >= 'a' && c <= 'h'; }
+
+static bool isRank(char c) { return c >= '1' && c <= '8'; }
+
+// Piece of an upper-case SAN letter, false if it is not one. Pawns have no letter.
+static bool pieceOf(char letter, piece_type& piece) {
+    switch (letter) {
+        case 'N':
+            piece = piece_type::knight;
+            return true;
+        case 'B':
+            piece = piece_type::bishop;
+            return true;
+        case 'R':
+            piece = piece_type::rook;
+            return true;
+        case 'Q':
+            piece = piece_type::queen;
+            return true;
+        case 'K':
+            piece = piece_type::king;
+            return true;
+        default:
+            return false;
+    }
+}
+
+result parseSan(chess& board, std::string_view san, ply& out) {
+    while (!san.empty() && std::string_view("+#!?").find(san.back()) != std::string_view::npos) {
+        san.remove_suffix(1);
+    }
+    bool wasChecked = board.isChecked();
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        position from = board.kingPosition(board.getPlayer());
+        if (from == position()) {
+            return result::no_piece;
+        }
+        position to = from + move::horiz(san.size() == 3 ? 2 : -2);
+        if (to == position()) {
+            return result::bad_move;
+        }
+        result r = board.validate(from, to, wasChecked);
+        out = ply(from, to);
+        return r;
+    }
+
+    piece_type type = piece_type::pawn;
+    if (!san.empty() && pieceOf(san.front(), type)) {
+        san.remove_prefix(1);
+    }
+    piece_type promote = piece_type::pawn;
+    if (type == piece_type::pawn && san.size() >= 3 && pieceOf(san.back(), promote)) {
+        san.remove_suffix(1);
+        if (san.back() == '=') {
+            san.remove_suffix(1);
+        }
+    }
+    if (san.size() < 2 || !isFile(san[san.size() - 2]) || !isRank(san.back())) {
+        return result::bad_move;
+    }
+    position to {san[san.size() - 2] - 'a' + 1, san.back() - '0'};
+    san.remove_suffix(2);
+    if (!san.empty() && san.back() == 'x') {
+        san.remove_suffix(1);
+    }
+    // What is left tells the piece apart: its file, rank or both.
+    int file = 0;
+    int rank = 0;
+    if (!san.empty() && isFile(san.front())) {
+        file = san.front() - 'a' + 1;
+        san.remove_prefix(1);
+    }
+    if (!san.empty() && isRank(san.front())) {
+        rank = san.front() - '0';
+        san.remove_prefix(1);
+    }
+    if (!san.empty() || promote == piece_type::king) {
+        return result::bad_move;
+    }
+    // A pawn names its file only when it captures.
+    if (type == piece_type::pawn && !file) {
+        file = to.file;
+    }
+
+    bitboard candidates = board.pieces(board.getPlayer(), type);
+    result failure = candidates ? result::bad_move : result::no_piece;
+    int found = 0;
+    while (candidates) {
+        position from = position::fromIndex(popSquare(candidates));
+        if ((file && from.file != file) || (rank && from.rank != rank)) {
+            continue;
+        }
+        result r = board.validate(from, to, wasChecked);
+        if (r == result::ok) {
+            out = ply(from, to, promote);
+            ++found;
+        } else if (failure == result::bad_move || failure == result::no_piece) {
+            failure = r;
+        }
+    }
+    if (found == 1) {
+        return result::ok;
+    }
+    return found > 1 ? result::bad_move : failure;
+}
+
+// Applies the tag pair between the brackets, only "FEN" matters.
+static bool applyTag(chess& board, std::string_view tag) {
+    if (tag.substr(0, 4) != "FEN ") {
+        return true;
+    }
+    std::size_t open = tag.find('"');
+    std::size_t close = tag.rfind('"');
+    return open != close && board.fromFEN(tag.substr(open + 1, close - open - 1));
+}
+
+game_report replayGame(std::string_view game, std::uint64_t number, game_record* record) {
+    game_report report;
+    report.number = number;
+    chess board;
+    if (record) {
+        record->start = board;
+        record->moves.clear();
+        record->outcome = game_outcome::unknown;
+    }
+    std::size_t i = 0;
+    // Skips to just past the first ‹c› or to the end.
+    auto skipPast = [&](char c) {
+        i = game.find(c, i);
+        i = i == std::string_view::npos ? game.size() : i + 1;
+    };
+    while (i < game.size()) {
+        char c = game[i];
+        if (isSpace(c)) {
+            ++i;
+        } else if (c == '[') {
+            std::size_t start = i + 1;
+            skipPast(']');
+            std::string_view tag = game.substr(start, i - start - 1);
+            if (!applyTag(board, tag)) {
+                report.outcome = result::bad_move;
+                report.move = tag;
+                return report;
+            }
+            if (record) {
+                record->start = board;
+            }
+        } else if (c == '{') {
+            skipPast('}');
+        } else if (c == ';') {
+            skipPast('\n');
+        } else if (c == '(') {
+            // Variations nest and may contain comments with parentheses.
+            for (int depth = 0; i < game.size(); ++i) {
+                if (game[i] == '{') {
+                    skipPast('}');
+                    --i;
+                } else if (game[i] == '(') {
+                    ++depth;
+                } else if (game[i] == ')' && --depth == 0) {
+                    ++i;
+                    break;
+                }
+            }
+        } else if (c == ')' || c == '}' || c == ']') {
+            // Stray closing bracket.
+            ++i;
+        } else {
+            std::size_t start = i;
+            while (i < game.size() && !isSpace(game[i]) && std::string_view("{}()[];").find(game[i]) ==
+                                                                 std::string_view::npos) {
+                ++i;
+            }
+            std::string_view token = game.substr(start, i - start);
+            if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+                if (record) {
+                    record->outcome = token == "1-0" ? game_outcome::white_wins
+                                    : token == "0-1" ? game_outcome::black_wins
+                                    : token == "*" ? game_outcome::unknown : game_outcome::draw;
+                }
+                break;
+            }
+            // Numeric annotation glyph.
+            if (token.front() == '$') {
+                continue;
+            }
+            // Move number, possibly glued to the move.
+            std::size_t digits = token.find_first_not_of("0123456789");
+            if (digits != 0 && digits != std::string_view::npos && token[digits] == '.') {
+                token.remove_prefix(std::min(token.find_first_not_of('.', digits), token.size()));
+            }
+            if (token.empty()) {
+                continue;
+            }
+            ply p;
+            result r = parseSan(board, token, p);
+            if (r == result::ok) {
+                r = board.play(p.origin(), p.target(), p.promote);
+            }
+            if (r != result::ok && r != result::capture) {
+                report.outcome = r;
+                report.move = token;
+                return report;
+            }
+            ++report.plies;
+            if (record) {
+                record->moves.push_back(p);
+            }
+        }
+    }
+    return report;
+}
+
+// Whole games of the input, ‹starts› are the offsets of the games in ‹text›.
+struct pgn_chunk {
+    std::string text;
+    std::vector<std::size_t> starts;
+    std::uint64_t first = 0;
+};
+
+// Chunks on their way from the reader to the workers, at most ‹capacity› of them.
+class chunk_queue {
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    std::deque<pgn_chunk> _chunks;
+    std::size_t _capacity;
+    bool _closed = false;
+
+public:
+    explicit chunk_queue(std::size_t capacity) : _capacity(capacity) {}
+
+    void push(pgn_chunk&& chunk) {
+        std::unique_lock lock(_mutex);
+        _changed.wait(lock, [this]() { return _chunks.size() < _capacity; });
+        _chunks.push_back(std::move(chunk));
+        _changed.notify_all();
+    }
+
+    // Returns false once the queue is closed and empty.
+    bool pop(pgn_chunk& chunk) {
+        std::unique_lock lock(_mutex);
+        _changed.wait(lock, [this]() { return !_chunks.empty() || _closed; });
+        if (_chunks.empty()) {
+            return false;
+        }
+        chunk = std::move(_chunks.front());
+        _chunks.pop_front();
+        _changed.notify_all();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard lock(_mutex);
+        _closed = true;
+        _changed.notify_all();
+    }
+};
+
+replay_stats replayPgn(std::FILE* input, int threads, const std::function<void(const game_report&)>& onFailure,
+                       const std::function<void(const game_report&, const game_record&)>& onGame) {
+    threads = std::max(1, threads);
+    chunk_queue queue(2 * static_cast<std::size_t>(threads));
+    replay_stats total;
+    std::mutex totalMutex;
+
+    auto work = [&]() {
+        replay_stats stats;
+        pgn_chunk chunk;
+        std::unique_ptr<game_record> record;
+        if (onGame) {
+            record = std::make_unique<game_record>();
+        }
+        while (queue.pop(chunk)) {
+            for (std::size_t g = 0; g < chunk.starts.size(); ++g) {
+                std::size_t end = g + 1 < chunk.starts.size() ? chunk.starts[g + 1] : chunk.text.size();
+                std::string_view text = std::string_view(chunk.text).substr(chunk.starts[g], end - chunk.starts[g]);
+                if (text.find_first_not_of(" \t\r\n") == std::string_view::npos) {
+                    continue;
+                }
+                game_report report = replayGame(text, chunk.first + g, record.get());
+                ++stats.games;
+                stats.plies += report.plies;
+                if (report.outcome != result::ok) {
+                    ++stats.failed;
+                }
+                if ((report.outcome != result::ok && onFailure) || onGame) {
+                    std::lock_guard lock(totalMutex);
+                    if (report.outcome != result::ok && onFailure) {
+                        onFailure(report);
+                    }
+                    if (onGame) {
+                        onGame(report, *record);
+                    }
+                }
+            }
+        }
+        std::lock_guard lock(totalMutex);
+        total.games += stats.games;
+        total.failed += stats.failed;
+        total.plies += stats.plies;
+    };
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back(work);
+    }
+
+    // The pending text always starts with a game, the lines before ‹scanned› are split already.
+    pgn_chunk pending;
+    pending.starts.push_back(0);
+    pending.first = 1;
+    std::size_t scanned = 0;
+    bool previousTag = false;
+    // Finds the games starting in the complete lines, or in all of the text at the end.
+    auto scan = [&](bool atEnd) {
+        for (;;) {
+            std::size_t end = pending.text.find('\n', scanned);
+            if (end == std::string::npos) {
+                if (!atEnd || scanned == pending.text.size()) {
+                    return;
+                }
+                end = pending.text.size();
+            }
+            std::size_t first = pending.text.find_first_not_of(" \t\r", scanned);
+            bool tag = first < end && pending.text[first] == '[';
+            if (tag && !previousTag && scanned != 0) {
+                pending.starts.push_back(scanned);
+            }
+            if (first < end) {
+                previousTag = tag;
+            }
+            scanned = end + 1;
+        }
+    };
+    auto hand = [&](std::size_t cut) {
+        pgn_chunk chunk;
+        chunk.first = pending.first;
+        chunk.text = pending.text.substr(0, cut);
+        auto split = std::lower_bound(pending.starts.begin(), pending.starts.end(), cut);
+        chunk.starts.assign(pending.starts.begin(), split);
+        pending.starts.erase(pending.starts.begin(), split);
+        pending.first += chunk.starts.size();
+        pending.text.erase(0, cut);
+        for (std::size_t& start: pending.starts) {
+            start -= cut;
+        }
+        scanned -= std::min(scanned, cut);
+        queue.push(std::move(chunk));
+    };
+    std::vector<char> block(pgn_chunk_size);
+    for (;;) {
+        std::size_t read = std::fread(block.data(), 1, block.size(), input);
+        total.bytes += read;
+        pending.text.append(block.data(), read);
+        scan(read == 0);
+        if (read == 0) {
+            break;
+        }
+        // The last game may not be complete yet, so it stays.
+        if (pending.text.size() >= pgn_chunk_size && pending.starts.size() > 1) {
+            hand(pending.starts.back());
+        }
+    }
+    hand(pending.text.size());
+    queue.close();
+    for (std::thread& t: workers) {
+        t.join();
+    }
+    return total;
+}
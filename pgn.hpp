@@ -0,0 +1,67 @@
+#pragma once
+
+#include "chess.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Decodes a move in standard algebraic notation («SAN», e.g. "Nbd7", "exd6",
+ * "O-O-O", "e8=Q+") into ‹out› for the player to move. Check and annotation
+ * suffixes are ignored and the disambiguation is only required where the legal
+ * moves need it. Returns ‹result::ok› if exactly one legal move matches, and
+ * otherwise explains the failure as ‹chess::validate› would: the result for the
+ * first piece that could make the move, ‹result::no_piece› if there is none and
+ * ‹result::bad_move› for malformed or ambiguous text. */
+result parseSan(chess& board, std::string_view san, ply& out);
+
+// Outcome of replaying a single game.
+struct game_report {
+    // Position of the game in the input, counted from 1.
+    std::uint64_t number = 0;
+    // Plies played before the game ended or failed.
+    int plies = 0;
+    // ‹result::ok› if every move was legal, otherwise the result of the first one that was not.
+    result outcome = result::ok;
+    // Text of the failing move, or of the "FEN" tag if the start position is invalid.
+    std::string move;
+};
+
+// Result token that ends the movetext, ‹unknown› for "*" or none.
+enum class game_outcome : std::uint8_t { unknown, white_wins, black_wins, draw };
+
+// The legal part of a replayed game.
+struct game_record {
+    chess start;
+    std::vector<ply> moves;
+    game_outcome outcome = game_outcome::unknown;
+};
+
+/* Replays one game: the tag pairs followed by the movetext. The game starts from
+ * the "FEN" tag if there is one. Comments, variations, move numbers and numeric
+ * annotations are skipped; the game ends with the result token or the text. The
+ * moves played are stored into ‹record› if given. */
+game_report replayGame(std::string_view game, std::uint64_t number = 1, game_record* record = nullptr);
+
+struct replay_stats {
+    std::uint64_t games = 0;
+    std::uint64_t failed = 0;
+    std::uint64_t plies = 0;
+    std::uint64_t bytes = 0;
+};
+
+// Amount of text handed to a worker at once, see ‹replayPgn›.
+constexpr std::size_t pgn_chunk_size = 1 << 20;
+
+/* Replays every game of a PGN stream on ‹threads› workers. The reader splits the
+ * input into chunks of whole games of about ‹pgn_chunk_size› bytes and keeps at most
+ * two chunks per worker in flight, so the memory use does not depend on the size
+ * of the input. A new game starts with a tag pair line that follows a line that
+ * is not one. ‹onFailure› is called for every game that fails and ‹onGame› for
+ * every game, from the worker threads but never from two at once. With a single
+ * thread the games come in the order of the input. */
+replay_stats replayPgn(std::FILE* input, int threads,
+                       const std::function<void(const game_report&)>& onFailure = nullptr,
+                       const std::function<void(const game_report&, const game_record&)>& onGame = nullptr);
@@ -0,0 +1,119 @@
+/* Replay: checks PGN files by playing out every move of every game.
+ *
+ *   replay [-t threads] [-o archive] [-b book] [file ...]
+ *
+ * Reads the standard input when no file is given. Every game with a move that is
+ * illegal or cannot be read is printed with the ‹result› of that move, followed by
+ * the totals and the throughput. Exits with 1 if any game failed. ‹-o› also writes
+ * the games into a binary archive (see ‹archive.hpp›), failed games up to their
+ * first bad move; the games are then replayed on one thread to keep their order.
+ * ‹-b› writes an opening book (see ‹book.hpp›) of the first ‹book_plies› plies of
+ * the games, a move weighing 2 for every win and 1 for every draw or unknown result
+ * of the player who made it. */
+
+#include "archive.hpp"
+#include "book.hpp"
+#include "pgn.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+static const char* resultName(result r) {
+    static const char* names[] = {"capture", "ok", "no_piece", "bad_piece", "bad_move", "blocked",
+                                  "lapsed", "in_check", "would_check", "has_moved", "bad_promote"};
+    return names[static_cast<int>(r)];
+}
+
+constexpr int book_plies = 20;
+
+static int usage() {
+    std::cerr << "usage: replay [-t threads] [-o archive] [-b book] [file ...]\n";
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    const char* output = nullptr;
+    const char* bookPath = nullptr;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i) {
+        if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (std::strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            bookPath = argv[++i];
+        } else {
+            return usage();
+        }
+    }
+    auto report = [](const char* name) {
+        return [name](const game_report& game) {
+            std::cout << name << ": game " << game.number << ", ply " << game.plies + 1 << " \"" << game.move
+                      << "\": " << resultName(game.outcome) << '\n';
+        };
+    };
+    archive_writer archive;
+    if (output) {
+        if (!archive.open(output)) {
+            std::cerr << "cannot write " << output << '\n';
+            return 1;
+        }
+        threads = 1;
+    }
+    book_builder book;
+    std::function<void(const game_report&, const game_record&)> store;
+    if (output || bookPath) {
+        store = [&](const game_report&, const game_record& record) {
+            if (output) {
+                archive.add(record);
+            }
+            if (bookPath) {
+                chess board = record.start;
+                for (std::size_t n = 0; n < record.moves.size() && n < book_plies; ++n) {
+                    player mover = board.getPlayer();
+                    game_outcome win = mover == player::white ? game_outcome::white_wins : game_outcome::black_wins;
+                    game_outcome loss = mover == player::white ? game_outcome::black_wins : game_outcome::white_wins;
+                    book.add(board, record.moves[n], record.outcome == win ? 2 : record.outcome == loss ? 0 : 1);
+                    board.makeMove(record.moves[n]);
+                }
+            }
+        };
+    }
+    auto start = std::chrono::steady_clock::now();
+    replay_stats total;
+    auto add = [&total](const replay_stats& stats) {
+        total.games += stats.games;
+        total.failed += stats.failed;
+        total.plies += stats.plies;
+        total.bytes += stats.bytes;
+    };
+    if (i == argc) {
+        add(replayPgn(stdin, threads, report("-"), store));
+    }
+    for (; i < argc; ++i) {
+        std::FILE* file = std::fopen(argv[i], "rb");
+        if (!file) {
+            std::cerr << "cannot open " << argv[i] << '\n';
+            return 1;
+        }
+        add(replayPgn(file, threads, report(argv[i]), store));
+        std::fclose(file);
+    }
+    if (output && !archive.close()) {
+        std::cerr << "cannot write " << output << '\n';
+        return 1;
+    }
+    if (bookPath && !book.write(bookPath)) {
+        std::cerr << "cannot write " << bookPath << '\n';
+        return 1;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = std::max(elapsed.count(), 1e-9);
+    std::cout << total.games << " games, " << total.failed << " failed, " << total.plies << " plies in "
+              << elapsed.count() << " s (" << static_cast<std::uint64_t>(total.games / seconds) << " games/s, "
+              << total.bytes / seconds / (1 << 20) << " MB/s)\n";
+    return total.failed ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+/* Scan: reads a game archive written by ‹replay -o›.
+ *
+ *   scan [-t threads] archive [game ...]
+ *
+ * Without game numbers every game is replayed position by position, split among
+ * the threads, and the throughput is printed. Otherwise the given games (counted
+ * from 1) are printed in coordinate notation together with their final FEN. */
+
+#include "archive.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+static const char* outcomeName(game_outcome outcome) {
+    static const char* names[] = {"*", "1-0", "0-1", "1/2-1/2"};
+    return names[static_cast<int>(outcome)];
+}
+
+static int usage() {
+    std::cerr << "usage: scan [-t threads] archive [game ...]\n";
+    return 2;
+}
+
+static int print(const archive_reader& archive, int argc, char* argv[]) {
+    for (int i = 0; i < argc; ++i) {
+        std::uint64_t n = std::strtoull(argv[i], nullptr, 10);
+        if (n < 1 || n > archive.size()) {
+            std::cerr << "no game " << argv[i] << '\n';
+            return 1;
+        }
+        archive_game game = archive.game(n - 1);
+        game_cursor cursor;
+        if (!cursor.reset(game)) {
+            std::cerr << "game " << n << ": bad start position\n";
+            return 1;
+        }
+        std::cout << "game " << n << ':';
+        ply p;
+        while (cursor.advance(p)) {
+            std::cout << ' ' << p.toString();
+        }
+        char fen[chess::max_fen_length];
+        cursor.board().toFEN(fen);
+        std::cout << ' ' << outcomeName(game.outcome) << "\n  " << fen << '\n';
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else {
+            return usage();
+        }
+    }
+    if (i == argc) {
+        return usage();
+    }
+    archive_reader archive;
+    if (!archive.open(argv[i])) {
+        std::cerr << "cannot read archive " << argv[i] << '\n';
+        return 1;
+    }
+    if (i + 1 < argc) {
+        return print(archive, argc - i - 1, argv + i + 1);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<std::uint64_t> next {0};
+    std::atomic<std::uint64_t> plies {0};
+    std::atomic<std::uint64_t> broken {0};
+    auto work = [&]() {
+        game_cursor cursor;
+        std::uint64_t count = 0;
+        // Games are taken in batches to keep the threads off the shared counter.
+        for (std::uint64_t first = next += 1024; first - 1024 < archive.size(); first = next += 1024) {
+            for (std::uint64_t n = first - 1024; n < std::min(first, archive.size()); ++n) {
+                archive_game game = archive.game(n);
+                ply p;
+                int played = 0;
+                if (cursor.reset(game)) {
+                    while (cursor.advance(p)) {
+                        ++played;
+                    }
+                }
+                if (played != static_cast<int>(game.plies())) {
+                    ++broken;
+                }
+                count += played;
+            }
+        }
+        plies += count;
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& t: workers) {
+        t.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = std::max(elapsed.count(), 1e-9);
+    std::cout << archive.size() << " games, " << plies << " plies, " << broken << " broken in " << elapsed.count()
+              << " s (" << static_cast<std::uint64_t>(archive.size() / seconds) << " games/s, "
+              << static_cast<std::uint64_t>(plies / seconds) << " positions/s)\n";
+    return broken ? 1 : 0;
+}
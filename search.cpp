@@ -0,0 +1,408 @@
+#include "search.hpp"
+#include "counters.hpp"
+#include "movepick.hpp"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+// Scores beyond this are mates found by the search.
+constexpr int mate_bound = mate_score - 2 * max_depth;
+constexpr int max_height = 2 * max_depth;
+
+// Mate scores are stored relative to the position, not to the root.
+static int toTable(int score, int height) {
+    if (score >= mate_bound) {
+        return score + height;
+    }
+    if (score <= -mate_bound) {
+        return score - height;
+    }
+    return score;
+}
+
+static int fromTable(int score, int height) {
+    if (score >= mate_bound) {
+        return score - height;
+    }
+    if (score <= -mate_bound) {
+        return score + height;
+    }
+    return score;
+}
+
+// Depths skipped by the helper threads: helper ‹i› skips blocks of ‹skip_size[i]› depths shifted
+// by ‹skip_phase[i]›.
+static const int skip_size[] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static const int skip_phase[] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+// State of one search thread over its own copy of the board.
+struct worker {
+    chess board;
+    // Moves of the game before the root, then those of the path searched.
+    move_history moves;
+    transposition_table& table;
+    // Raised by ‹engine::stop›.
+    const std::atomic<bool>& cancelled;
+    // Raised by the main thread when a limit is reached or the search is over.
+    std::atomic<bool>& halt;
+    const search_limits& limits;
+    std::chrono::steady_clock::time_point start;
+    // Zero for the main thread, whose result is the result of the search.
+    int id;
+    // Nodes of all threads, every thread adds its count in batches.
+    std::atomic<std::uint64_t>& totalNodes;
+    // Null when no network is loaded.
+    const network* net;
+    const tablebases* endings;
+
+    std::uint64_t nodes = 0;
+    int completed = 0;
+    // Time spent pondering, not counted against the time limit.
+    std::chrono::milliseconds pondered {0};
+    ply killers[max_height + 1][2] {};
+    int history[2][64][64] {};
+    ply pv[max_height + 1][max_height + 1] {};
+    int pvLength[max_height + 1] {};
+    // Accumulators of the network for the positions on the path from the root.
+    nnue_accumulator accumulators[max_height + 1];
+
+    worker(const chess& board, const move_history& moves, transposition_table& table,
+           const std::atomic<bool>& cancelled, std::atomic<bool>& halt, const search_limits& limits, std::chrono::steady_clock::time_point start, int id,
+           std::atomic<std::uint64_t>& totalNodes, const network* net, const tablebases* endings)
+        :   board(board), moves(moves), table(table), cancelled(cancelled), halt(halt), limits(limits), start(start), id(id),
+            totalNodes(totalNodes),
+            net(net), endings(endings) {
+        if (net) {
+            net->refresh(board, accumulators[0]);
+        }
+    }
+
+    std::chrono::milliseconds elapsed() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    }
+
+    // Called every 1024 nodes. Only the main thread looks at the limits, and not before
+    // it finishes the first iteration.
+    void checkLimits() {
+        std::uint64_t total = totalNodes += 1024;
+        if (id != 0) {
+            return;
+        }
+        if (limits.pondering && limits.pondering->load(std::memory_order_relaxed)) {
+            pondered = elapsed();
+            return;
+        }
+        if (!limits.infinite && completed > 0 && ((limits.nodes && total >= limits.nodes) ||
+                              (limits.time.count() && elapsed() - pondered >= limits.time))) {
+            halt = true;
+        }
+    }
+
+    bool stopped() const {
+        return halt.load(std::memory_order_relaxed) || cancelled.load(std::memory_order_relaxed);
+    }
+
+    // Kept clear of the mate scores, whatever the network says.
+    int staticEval(int height) const {
+        int score = net ? net->evaluate(board, accumulators[height]) : evaluate(board);
+        return std::clamp(score, -mate_bound + 1, mate_bound - 1);
+    }
+
+    void makeMove(ply p, int height) {
+        board.makeMove(p, moves);
+        if (net) {
+            net->update(accumulators[height], board, moves.last(), accumulators[height + 1]);
+        }
+    }
+
+    void makeNullMove(int height) {
+        board.makeNullMove(moves);
+        if (net) {
+            accumulators[height + 1] = accumulators[height];
+        }
+    }
+
+    void updatePv(int height, ply p) {
+        pv[height][height] = p;
+        for (int i = height + 1; i < pvLength[height + 1]; ++i) {
+            pv[height][i] = pv[height + 1][i];
+        }
+        pvLength[height] = std::max(pvLength[height + 1], height + 1);
+    }
+
+    int quiesce(int alpha, int beta, int height) {
+        pvLength[height] = height;
+        countStat(counter::quiescence_nodes);
+        if ((++nodes & 1023) == 0) {
+            checkLimits();
+        }
+        if (stopped() || height >= max_height) {
+            return staticEval(height);
+        }
+        bool inCheck = board.isChecked();
+        int best = -infinite_score;
+        if (!inCheck) {
+            best = staticEval(height);
+            if (best >= beta) {
+                return best;
+            }
+            alpha = std::max(alpha, best);
+        }
+        // In check every move is tried, otherwise only captures and queen promotions.
+        move_picker picker = inCheck ? move_picker(board, ply(), killers[height], history[side()])
+                                     : move_picker::noisyOnly(board);
+        ply p;
+        while (picker.next(p)) {
+            if (!inCheck && !board.isCapture(p) && p.promote != piece_type::queen) {
+                continue;
+            }
+            makeMove(p, height);
+            int score = -quiesce(-beta, -alpha, height + 1);
+            board.unmakeMove(moves);
+            if (stopped()) {
+                return 0;
+            }
+            if (score > best) {
+                best = score;
+                if (score > alpha) {
+                    alpha = score;
+                    updatePv(height, p);
+                    if (score >= beta) {
+                        break;
+                    }
+                }
+            }
+        }
+        // Without a capture to try the position is not checked for a stalemate.
+        return best == -infinite_score ? -mate_score + height : best;
+    }
+
+    int negamax(int depth, int alpha, int beta, int height, bool nullAllowed) {
+        pvLength[height] = height;
+        if (depth <= 0) {
+            return quiesce(alpha, beta, height);
+        }
+        countStat(counter::nodes);
+        if ((++nodes & 1023) == 0) {
+            checkLimits();
+        }
+        if (stopped() || height >= max_height) {
+            return staticEval(height);
+        }
+        std::uint64_t key = board.key();
+        if (height > 0) {
+            // A single repetition is enough, also of a position played before the root.
+            if (board.repetitions(moves) > 0 || board.halfmoveClock() >= 100) {
+                return 0;
+            }
+            // No mate found below can be shorter than the one already known.
+            alpha = std::max(alpha, -mate_score + height);
+            beta = std::min(beta, mate_score - height - 1);
+            if (alpha >= beta) {
+                return alpha;
+            }
+            tb_result known;
+            if (endings && endings->probe(board, known)) {
+                countStat(counter::tablebase_hits);
+                if (known.outcome == tb_outcome::draw) {
+                    return 0;
+                }
+                int score = mate_score - height - known.plies;
+                return known.outcome == tb_outcome::win ? score : -score;
+            }
+        }
+        bool pvNode = beta - alpha > 1;
+
+        tt_entry entry;
+        ply hashMove;
+        countStat(counter::table_probes);
+        if (table.probe(key, entry)) {
+            countStat(counter::table_hits);
+            hashMove = entry.move;
+            int score = fromTable(entry.score, height);
+            if (!pvNode && entry.depth >= depth &&
+                (entry.type == bound::exact || (entry.type == bound::lower && score >= beta) ||
+                 (entry.type == bound::upper && score <= alpha))) {
+                return score;
+            }
+        }
+
+        bool inCheck = board.isChecked();
+        if (inCheck) {
+            ++depth;
+        }
+        // Null move: if passing still keeps the score above beta, a real move will too.
+        if (nullAllowed && !pvNode && !inCheck && depth >= 3 && hasPieces() && staticEval(height) >= beta) {
+            int reduction = 2 + depth / 6;
+            makeNullMove(height);
+            int score = -negamax(depth - 1 - reduction, -beta, -beta + 1, height + 1, false);
+            board.unmakeMove(moves);
+            if (stopped()) {
+                return 0;
+            }
+            if (score >= beta) {
+                return score >= mate_bound ? beta : score;
+            }
+        }
+
+        move_picker picker(board, hashMove, killers[height], history[side()]);
+        int best = -infinite_score;
+        ply bestMove;
+        bound type = bound::upper;
+        ply p;
+        for (int i = 0; picker.next(p); ++i) {
+            bool quiet = !board.isCapture(p) && p.promote == piece_type::pawn;
+            makeMove(p, height);
+            int score;
+            if (i == 0) {
+                score = -negamax(depth - 1, -beta, -alpha, height + 1, true);
+            } else {
+                // Late quiet moves are unlikely to be best, they get a shallower search first.
+                int reduction = 0;
+                if (depth >= 3 && i >= 3 && quiet && !inCheck && !board.isChecked()) {
+                    reduction = 1 + (i >= 8) + (depth >= 8);
+                }
+                score = -negamax(depth - 1 - reduction, -alpha - 1, -alpha, height + 1, true);
+                if (score > alpha && reduction > 0) {
+                    score = -negamax(depth - 1, -alpha - 1, -alpha, height + 1, true);
+                }
+                if (score > alpha && score < beta) {
+                    score = -negamax(depth - 1, -beta, -alpha, height + 1, true);
+                }
+            }
+            board.unmakeMove(moves);
+            if (stopped()) {
+                return 0;
+            }
+            if (score > best) {
+                best = score;
+                bestMove = p;
+                if (score > alpha) {
+                    alpha = score;
+                    type = bound::exact;
+                    updatePv(height, p);
+                    if (score >= beta) {
+                        countStat(counter::beta_cutoffs);
+                        type = bound::lower;
+                        if (quiet) {
+                            if (killers[height][0] != p) {
+                                killers[height][1] = killers[height][0];
+                                killers[height][0] = p;
+                            }
+                            int& h = history[side()][p.from][p.to];
+                            h = std::min(h + depth * depth, 1 << 20);
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        if (best == -infinite_score) {
+            return inCheck ? -mate_score + height : 0;
+        }
+        table.store(key, bestMove, toTable(best, height), depth, type);
+        return best;
+    }
+
+    int side() const { return static_cast<int>(board.getPlayer()); }
+
+    // Null moves are unsafe with only pawns left, where passing may be the best move.
+    bool hasPieces() const {
+        player p = board.getPlayer();
+        return board.pieces(p) & ~(board.pieces(p, piece_type::pawn) | board.pieces(p, piece_type::king));
+    }
+
+    search_result iterate(const search_callback& onIteration) {
+        search_result result;
+        int previous = 0;
+        for (int depth = 1; depth <= std::min(limits.depth, max_depth); ++depth) {
+            if (id > 0) {
+                int i = (id - 1) % std::size(skip_size);
+                if (((depth + skip_phase[i]) / skip_size[i]) % 2) {
+                    continue;
+                }
+            }
+            int delta = 25;
+            int alpha = -infinite_score;
+            int beta = infinite_score;
+            if (depth >= 5) {
+                alpha = std::max(previous - delta, -infinite_score);
+                beta = std::min(previous + delta, infinite_score);
+            }
+            int score;
+            while (true) {
+                score = negamax(depth, alpha, beta, 0, false);
+                if (stopped()) {
+                    break;
+                }
+                if (score <= alpha) {
+                    alpha = std::max(score - delta, -infinite_score);
+                } else if (score >= beta) {
+                    beta = std::min(score + delta, infinite_score);
+                } else {
+                    break;
+                }
+                delta *= 2;
+            }
+            // A stopped iteration is thrown away, except when there is no result yet.
+            if (stopped() && result.depth > 0) {
+                break;
+            }
+            previous = score;
+            completed = depth;
+            result.depth = depth;
+            result.score = score;
+            result.pv.assign(pv[0], pv[0] + pvLength[0]);
+            result.best = result.pv.empty() ? ply() : result.pv[0];
+            result.nodes = totalNodes + (nodes & 1023);
+            result.time = elapsed();
+            if (onIteration) {
+                onIteration(result);
+            }
+            // Nothing shorter than a mate within the searched depth can be found deeper.
+            if (stopped() || result.pv.empty() || (std::abs(score) >= mate_bound && mate_score - std::abs(score) <= depth)) {
+                break;
+            }
+        }
+        result.nodes = totalNodes + (nodes & 1023);
+        result.time = elapsed();
+        return result;
+    }
+};
+
+engine::engine(std::size_t hashMegabytes)
+    :   _table(hashMegabytes) {}
+
+search_result engine::search(const chess& board, const search_limits& limits, const search_callback& onIteration) {
+    return search(board, move_history(), limits, onIteration);
+}
+
+search_result engine::search(const chess& board, const move_history& moves, const search_limits& limits,
+                             const search_callback& onIteration) {
+    stat_timer timer(counter::search);
+    _table.newSearch();
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<std::uint64_t> totalNodes {0};
+    std::atomic<bool> halt {false};
+    std::vector<std::unique_ptr<worker>> workers;
+    for (int id = 0; id < _threads; ++id) {
+        workers.push_back(std::make_unique<worker>(board, moves, _table, _stop, halt, limits, start, id,
+                                                   totalNodes, _network.loaded() ? &_network : nullptr,
+                                                   _tablebases));
+    }
+    std::vector<std::thread> helpers;
+    for (int id = 1; id < _threads; ++id) {
+        helpers.emplace_back([&helper = *workers[id]]() { helper.iterate(nullptr); });
+    }
+    search_result result = workers[0]->iterate(onIteration);
+    // The helpers only run until the main thread is done.
+    halt = true;
+    for (std::thread& t: helpers) {
+        t.join();
+    }
+    result.nodes = totalNodes;
+    for (auto& w: workers) {
+        result.nodes += w->nodes & 1023;
+    }
+    return result;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "chess.hpp"
+#include "eval.hpp"
+#include "nnue.hpp"
+#include "tablebase.hpp"
+#include "transposition.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+// Scores are in centipawns from the point of view of the player to move. A mate in
+// ‹n› plies scores ‹mate_score - n›.
+constexpr int mate_score = 32000;
+constexpr int infinite_score = 32001;
+constexpr int max_depth = 64;
+
+// Limits of a single search, zero means no limit. Unless stopped by ‹engine::stop› the search
+// always finishes depth 1.
+struct search_limits {
+    int depth = max_depth;
+    std::uint64_t nodes = 0;
+    std::chrono::milliseconds time {0};
+    // While this points to true the search «ponders»: it ignores the node and time limits, and
+    // the time is counted from the moment it turns false.
+    const std::atomic<bool>* pondering = nullptr;
+    // Searches until stopped, as «go infinite» asks: the node and time limits are ignored, and an
+    // ‹analysis› holds back the result until ‹analysis::stop›.
+    bool infinite = false;
+};
+
+// Outcome of the deepest finished iteration.
+struct search_result {
+    ply best;
+    int score = 0;
+    int depth = 0;
+    std::uint64_t nodes = 0;
+    std::chrono::milliseconds time {0};
+    // Principal variation, starts with ‹best›. Empty when there is no legal move.
+    std::vector<ply> pv;
+};
+
+// Called after every finished iteration of the search.
+using search_callback = std::function<void(const search_result&)>;
+
+/* Negamax alpha-beta search with iterative deepening and aspiration windows. The
+ * tree is pruned with null moves, late quiet moves are searched with reduced
+ * depth and the leaves are resolved by a quiescence search of captures. Results
+ * are kept in a transposition table between searches.
+ *
+ * With more than one thread the search is «lazy SMP»: helper threads search the
+ * same root on their own copies of the board, skipping some depths so that they
+ * run ahead of the main thread, and help it only through the shared table. The
+ * result is always the one of the main thread. With one thread the search is
+ * deterministic under a depth or node limit.
+ *
+ * Positions are evaluated by ‹evaluate›, or by the network once one is loaded.
+ * Positions covered by the tablebases given to the engine score their exact
+ * value. */
+class engine {
+    transposition_table _table;
+    std::atomic<bool> _stop {false};
+    int _threads = 1;
+    network _network;
+    const tablebases* _tablebases = nullptr;
+
+public:
+    explicit engine(std::size_t hashMegabytes = 16);
+
+    search_result search(const chess& board, const search_limits& limits, const search_callback& onIteration = nullptr);
+
+    // Searches ‹board› reached by ‹moves›, which count for repetitions.
+    search_result search(const chess& board, const move_history& moves, const search_limits& limits,
+                         const search_callback& onIteration = nullptr);
+
+    /* Clears a ‹stop›. A search does not clear it itself, so that a ‹stop› made
+     * while the search is on its way to another thread is not lost: the caller
+     * calls ‹prepare› before handing the search off, and a ‹stop› from then on
+     * ends the search, even one that has not begun yet. */
+    void prepare() { _stop = false; }
+
+    // Makes the running search return as soon as possible, and every later one until ‹prepare›.
+    // May be called from any thread.
+    void stop() { _stop = true; }
+
+    bool stopping() const { return _stop; }
+
+    // Forgets everything learned from previous searches.
+    void clear() { _table.clear(); }
+
+    transposition_table& table() { return _table; }
+
+    // Number of threads used by the next search, at least one.
+    void setThreads(int threads) { _threads = std::max(1, threads); }
+
+    int threads() const { return _threads; }
+
+    // Evaluates with the network from the file from the next search on. Returns false if the file
+    // cannot be loaded.
+    bool loadNetwork(const char* path) { return _network.load(path); }
+
+    // Probes the tables from the next search on, nullptr stops it. The tables must outlive the
+    // searches.
+    void setTablebases(const tablebases* tables) { _tablebases = tables; }
+};
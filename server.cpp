@@ -0,0 +1,185 @@
+/* Server: hosts many games at once and checks their moves.
+ *
+ *   server [-t threads] [-g games]
+ *
+ * Reads requests from the standard input, one per line, and answers each on a
+ * line of the standard output. ‹-g› is the most games played at once (4096 by
+ * default), ‹-t› the number of workers (one per core by default); see
+ * ‹game_host›. The answers to the requests of one game come in order, those of
+ * different games may not.
+ *
+ * ├┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┼┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┤
+ * │ new [fen]        │ game ‹id›, or error full, or error fen                  │
+ * │ move ‹id› ‹move› │ ok ‹id› ‹move› ‹status› or illegal ‹id› ‹move› ‹result› │
+ * │ show ‹id›        │ fen ‹id› ‹fen› ‹status›                                 │
+ * │ end ‹id›         │ ended ‹id›                                              │
+ * │ quit             │ stops reading, as does the end of the input             │
+ *
+ * A move is in coordinate notation, as "e2e4" or "e7e8q". A request for a game
+ * that is not being played, even if a new game took its place, is answered with
+ * unknown ‹id›, a line that cannot be read with error followed by the line. The
+ * totals and the throughput go to the standard error at the end. */
+
+#include "gamehost.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+static const char* resultName(result r) {
+    static const char* names[] = {"capture", "ok", "no_piece", "bad_piece", "bad_move", "blocked",
+                                  "lapsed", "in_check", "would_check", "has_moved", "bad_promote"};
+    return names[static_cast<int>(r)];
+}
+
+static const char* statusName(game_status s) {
+    static const char* names[] = {"ongoing", "checkmate", "stalemate", "repetition", "fifty_moves",
+                                  "insufficient_material"};
+    return names[static_cast<int>(s)];
+}
+
+// Requests read before they are handed to the workers, unless the input runs dry first.
+constexpr std::size_t batch_size = 256;
+
+static std::mutex output_mutex;
+
+static void say(const std::string& text) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::cout.write(text.data(), text.size());
+    std::cout.flush();
+}
+
+static void describe(const game_reply& reply, std::string& out) {
+    std::string id = std::to_string(reply.request.game);
+    if (!reply.known) {
+        out += "unknown " + id + '\n';
+        return;
+    }
+    switch (reply.request.type) {
+    case game_request::kind::move:
+        if (reply.outcome > result::ok) {
+            out += "illegal " + id + ' ' + reply.request.move.toString() + ' ' + resultName(reply.outcome) + '\n';
+        } else {
+            out += "ok " + id + ' ' + reply.request.move.toString() + ' ' + statusName(reply.status) + '\n';
+        }
+        break;
+    case game_request::kind::show: {
+        char fen[chess::max_fen_length];
+        reply.board->toFEN(fen);
+        out += "fen " + id + ' ' + fen + ' ' + statusName(reply.status) + '\n';
+        break;
+    }
+    case game_request::kind::end:
+        out += "ended " + id + '\n';
+        break;
+    }
+}
+
+// Reads a request for a game into ‹request›, false if the line is not one.
+static bool readRequest(std::istringstream& line, const std::string& word, game_request& request) {
+    if (word == "move") {
+        request.type = game_request::kind::move;
+    } else if (word == "show") {
+        request.type = game_request::kind::show;
+    } else if (word == "end") {
+        request.type = game_request::kind::end;
+    } else {
+        return false;
+    }
+    std::string text;
+    if (!(line >> request.game)) {
+        return false;
+    }
+    if (request.type == game_request::kind::move && !(line >> text && ply::fromString(text, request.move))) {
+        return false;
+    }
+    return true;
+}
+
+static int usage() {
+    std::cerr << "usage: server [-t threads] [-g games]\n";
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    long games = 4096;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            games = std::atol(argv[++i]);
+            if (games < 1 || games > std::numeric_limits<std::uint32_t>::max()) {
+                return usage();
+            }
+        } else {
+            return usage();
+        }
+    }
+    std::ios::sync_with_stdio(false);
+
+    std::atomic<std::uint64_t> moves {0};
+    std::atomic<std::uint64_t> illegal {0};
+    std::uint64_t started = 0;
+    auto begin = std::chrono::steady_clock::now();
+    {
+        game_host host(static_cast<std::uint32_t>(games), threads, [&](const std::vector<game_reply>& replies) {
+            thread_local std::string out;
+            out.clear();
+            std::uint64_t played = 0;
+            std::uint64_t rejected = 0;
+            for (const game_reply& reply: replies) {
+                describe(reply, out);
+                if (reply.known && reply.request.type == game_request::kind::move) {
+                    ++(reply.outcome > result::ok ? rejected : played);
+                }
+            }
+            moves += played;
+            illegal += rejected;
+            say(out);
+        });
+
+        std::vector<game_request> batch;
+        batch.reserve(batch_size);
+        std::string text;
+        while (std::getline(std::cin, text)) {
+            std::istringstream line(text);
+            std::string word;
+            line >> word;
+            game_request request;
+            if (word == "quit") {
+                break;
+            } else if (word == "new") {
+                std::string fen;
+                std::getline(line >> std::ws, fen);
+                create_error error;
+                game_id id = host.create(fen, error);
+                if (id != no_game) {
+                    ++started;
+                    say("game " + std::to_string(id) + '\n');
+                } else {
+                    say(error == create_error::full ? "error full\n" : "error fen\n");
+                }
+            } else if (readRequest(line, word, request)) {
+                batch.push_back(request);
+            } else if (!word.empty()) {
+                say("error " + text + '\n');
+            }
+            if (batch.size() >= batch_size || (!batch.empty() && std::cin.rdbuf()->in_avail() <= 0)) {
+                host.submit(batch);
+                batch.clear();
+            }
+        }
+        host.submit(batch);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    std::cerr << started << " games, " << moves << " moves, " << illegal << " illegal, " << elapsed.count()
+              << " s, " << static_cast<std::uint64_t>((moves + illegal) / std::max(elapsed.count(), 1e-9))
+              << " moves/s\n";
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "stats.hpp"
+#include <atomic>
+#include <iterator>
+#include <vector>
+
+const char* counterName(counter s) {
+    static const char* names[] = {"play", "is_checked", "would_check", "is_blocked", "generate",
+                                  "generated_moves", "search", "nodes", "quiescence_nodes", "beta_cutoffs",
+                                  "table_probes", "table_hits", "tablebase_hits"};
+    static_assert(std::size(names) == counter_count);
+    return names[static_cast<int>(s)];
+}
+
+stats_snapshot stats_snapshot::operator-(const stats_snapshot& earlier) const {
+    stats_snapshot difference;
+    for (int i = 0; i < counter_count; ++i) {
+        difference.counts[i] = counts[i] - earlier.counts[i];
+        difference.nanoseconds[i] = nanoseconds[i] - earlier.nanoseconds[i];
+    }
+    return difference;
+}
+
+void stats_snapshot::print(std::ostream& out) const {
+    for (int i = 0; i < counter_count; ++i) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        out << counterName(static_cast<counter>(i)) << ' ' << counts[i];
+        if (nanoseconds[i]) {
+            out << ' ' << nanoseconds[i] / 1000000 << " ms " << nanoseconds[i] / counts[i] << " ns/call";
+        }
+        out << '\n';
+    }
+}
+
+// Written only by its own thread, read by the snapshots.
+struct alignas(64) stats_slot {
+    std::atomic<std::uint64_t> counts[counter_count] {};
+    std::atomic<std::uint64_t> nanoseconds[counter_count] {};
+};
+
+struct stats_registry {
+    std::mutex mutex;
+    std::vector<const stats_slot*> running;
+    stats_snapshot finished;
+};
+
+// Never destroyed, threads may still finish while the program exits.
+static stats_registry& registry() {
+    static stats_registry* r = new stats_registry;
+    return *r;
+}
+
+static void addSlot(const stats_slot& slot, stats_snapshot& out) {
+    for (int i = 0; i < counter_count; ++i) {
+        out.counts[i] += slot.counts[i].load(std::memory_order_relaxed);
+        out.nanoseconds[i] += slot.nanoseconds[i].load(std::memory_order_relaxed);
+    }
+}
+
+// Slot of a thread, registered on its first count and folded into the totals when it ends.
+class thread_stats {
+    stats_slot _slot;
+
+public:
+    thread_stats() {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        registry().running.push_back(&_slot);
+    }
+
+    ~thread_stats() {
+        stats_registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        addSlot(_slot, r.finished);
+        std::erase(r.running, &_slot);
+    }
+
+    stats_slot& slot() { return _slot; }
+};
+
+void addStat(counter s, std::uint64_t count, std::uint64_t nanoseconds) {
+    if constexpr (stats_enabled) {
+        thread_local thread_stats local;
+        stats_slot& slot = local.slot();
+        int i = static_cast<int>(s);
+        // No other thread writes the slot, so there is no need for an atomic addition.
+        slot.counts[i].store(slot.counts[i].load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        slot.nanoseconds[i].store(slot.nanoseconds[i].load(std::memory_order_relaxed) + nanoseconds,
+                                  std::memory_order_relaxed);
+    }
+}
+
+stats_snapshot takeStats() {
+    stats_snapshot snapshot;
+    if constexpr (stats_enabled) {
+        stats_registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        snapshot = r.finished;
+        for (const stats_slot* slot: r.running) {
+            addSlot(*slot, snapshot);
+        }
+    }
+    return snapshot;
+}
+
+stats_reporter::stats_reporter(std::ostream& out, std::chrono::milliseconds interval)
+    :   _out(out), _interval(interval) {
+    if constexpr (stats_enabled) {
+        _thread = std::thread([this]() { run(); });
+    }
+}
+
+stats_reporter::~stats_reporter() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _done = true;
+    }
+    _wake.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void stats_reporter::run() {
+    stats_snapshot previous = takeStats();
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_wake.wait_for(lock, _interval, [this]() { return _done; })) {
+        stats_snapshot current = takeStats();
+        _out << "stats of the last " << _interval.count() << " ms\n";
+        (current - previous).print(_out);
+        _out.flush();
+        previous = current;
+    }
+}
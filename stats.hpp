@@ -0,0 +1,55 @@
+#pragma once
+
+#include "counters.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+/* Counters and timers of the hot paths, compiled in only with ‹CHESS_STATS›
+ * defined. Without it ‹countStat› and ‹stat_timer› are empty, every snapshot is
+ * zero and no thread is started.
+ *
+ * Each thread counts into its own slot, so counting takes no lock and shares no
+ * cache line. A snapshot adds up the slots of the running threads and the totals
+ * of the finished ones. A timer counts a call and the nanoseconds it takes,
+ * including the calls timed inside it; timing costs two clock reads, so the
+ * timed functions run slower with the counters on. */
+
+struct stats_snapshot {
+    std::uint64_t counts[counter_count] = {};
+    // Time spent in the timed ones.
+    std::uint64_t nanoseconds[counter_count] = {};
+
+    std::uint64_t operator[](counter s) const { return counts[static_cast<int>(s)]; }
+
+    // What happened since ‹earlier›.
+    stats_snapshot operator-(const stats_snapshot& earlier) const;
+
+    // One line per counter that is not zero, with the average time of the timed ones.
+    void print(std::ostream& out) const;
+};
+
+stats_snapshot takeStats();
+
+// Prints what happened in every interval until destroyed. Does nothing without ‹CHESS_STATS›.
+class stats_reporter {
+    std::ostream& _out;
+    std::chrono::milliseconds _interval;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    bool _done = false;
+    std::thread _thread;
+
+    void run();
+
+public:
+    stats_reporter(std::ostream& out, std::chrono::milliseconds interval);
+
+    stats_reporter(const stats_reporter&) = delete;
+
+    stats_reporter& operator=(const stats_reporter&) = delete;
+
+    ~stats_reporter();
+};
@@ -0,0 +1,644 @@
+#include "tablebase.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+static_assert(sizeof(tablebase_header) == 32, "the header has no padding");
+
+// Order of the pieces of a side in a material, and their letters indexed by ‹piece_type›.
+static const char material_order[] = "KQRBNP";
+static const char piece_letters[] = "PRNBQK";
+static const int piece_strength[6] = {1, 5, 3, 3, 9, 0};
+
+// Move count of the positions that cannot occur.
+constexpr std::uint8_t impossible = 255;
+
+static int pieceIndex(char letter) {
+    const char* found = std::strchr(piece_letters, letter);
+    return letter && found ? static_cast<int>(found - piece_letters) : -1;
+}
+
+static player other(player p) {
+    return p == player::white ? player::black : player::white;
+}
+
+static std::uint64_t materialKey(player owner, piece_type type) {
+    return std::uint64_t(1) << (4 * (6 * static_cast<int>(owner) + static_cast<int>(type)));
+}
+
+// The key with the colours of the pieces swapped.
+static std::uint64_t swapColours(std::uint64_t key) {
+    return key >> 24 | (key & 0xffffff) << 24;
+}
+
+static std::uint8_t encode(tb_outcome outcome, int plies) {
+    switch (outcome) {
+        case tb_outcome::win:
+            return static_cast<std::uint8_t>((plies + 1) / 2);
+        case tb_outcome::loss:
+            return static_cast<std::uint8_t>(128 + plies / 2);
+        default:
+            return 0;
+    }
+}
+
+static tb_result decode(std::uint8_t value) {
+    tb_result r;
+    if (value >= 128) {
+        r.outcome = tb_outcome::loss;
+        r.plies = 2 * (value - 128);
+    } else if (value > 0) {
+        r.outcome = tb_outcome::win;
+        r.plies = 2 * value - 1;
+    }
+    return r;
+}
+
+// Orders results from the point of view of the player to move, the best is the largest.
+static int rank(tb_result r) {
+    switch (r.outcome) {
+        case tb_outcome::win:
+            return 1000 - r.plies;
+        case tb_outcome::loss:
+            return -1000 + r.plies;
+        default:
+            return 0;
+    }
+}
+
+// Runs ‹work(begin, end, thread)› over blocks of [0, ‹size›) on ‹threads› threads.
+template <typename Work>
+static void parallelFor(int threads, std::size_t size, Work work) {
+    constexpr std::size_t block = 4096;
+    std::atomic<std::size_t> next {0};
+    auto run = [&](int thread) {
+        for (std::size_t begin = next.fetch_add(block); begin < size; begin = next.fetch_add(block)) {
+            work(begin, std::min(begin + block, size), thread);
+        }
+    };
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < threads; ++i) {
+        helpers.emplace_back(run, i);
+    }
+    run(0);
+    for (std::thread& t: helpers) {
+        t.join();
+    }
+}
+
+bool tablebases::parse(std::string_view material, table& out) {
+    std::size_t split = material.find('K', 1);
+    if (material.size() > max_tablebase_pieces || material.empty() || material[0] != 'K' ||
+        split == std::string_view::npos || material.find('K', split + 1) != std::string_view::npos) {
+        return false;
+    }
+    std::string sides[2] = {std::string(material.substr(0, split)), std::string(material.substr(split))};
+    int strength[2] = {0, 0};
+    for (int side = 0; side < 2; ++side) {
+        for (char letter: sides[side]) {
+            if (pieceIndex(letter) < 0) {
+                return false;
+            }
+            strength[side] += 16 * piece_strength[pieceIndex(letter)] + 1;
+        }
+        std::sort(sides[side].begin(), sides[side].end(), [](char a, char b) {
+            return std::strchr(material_order, a) < std::strchr(material_order, b);
+        });
+    }
+    if (sides[0].find('P') != std::string::npos && sides[1].find('P') != std::string::npos) {
+        return false;
+    }
+    if (strength[1] > strength[0] || (strength[1] == strength[0] && sides[1] < sides[0])) {
+        std::swap(sides[0], sides[1]);
+    }
+    out.material = sides[0] + sides[1];
+    out.size = 0;
+    out.key = 0;
+    for (int side = 0; side < 2; ++side) {
+        for (char letter: sides[side]) {
+            out.owners[out.size] = side == 0 ? player::white : player::black;
+            out.types[out.size] = static_cast<piece_type>(pieceIndex(letter));
+            out.key += materialKey(out.owners[out.size], out.types[out.size]);
+            ++out.size;
+        }
+    }
+    return true;
+}
+
+const tablebases::table* tablebases::find(std::string_view material) const {
+    table t;
+    if (!parse(material, t)) {
+        return nullptr;
+    }
+    for (const table& held: _tables) {
+        if (held.material == t.material) {
+            return &held;
+        }
+    }
+    return nullptr;
+}
+
+bool tablebases::build(table& t, int threads) const {
+    std::size_t positions = std::size_t(2) << (6 * t.size);
+    auto values = std::make_unique<std::atomic<std::uint8_t>[]>(positions);
+    auto counts = std::make_unique<std::atomic<std::uint8_t>[]>(positions);
+    // One more than the best value reached by leaving the table, zero if no move does.
+    std::vector<std::uint8_t> exits(positions);
+    // Positions whose value is known from the start, resolved when the analysis reaches their
+    // depth: the mates and those decided by leaving the table.
+    std::vector<std::vector<std::uint32_t>> pending(256);
+    std::vector<std::vector<std::pair<std::uint8_t, std::uint32_t>>> found(threads);
+    std::atomic<bool> missing {false};
+
+    auto squaresOf = [&](std::size_t index, int squares[]) {
+        for (int i = t.size - 1; i >= 0; --i, index >>= 6) {
+            squares[i] = static_cast<int>(index & 63);
+        }
+        return index == 0 ? player::white : player::black;
+    };
+
+    // Every position is set up and its moves are generated by the rules of ‹chess›.
+    parallelFor(threads, positions, [&](std::size_t begin, std::size_t end, int thread) {
+        chess board;
+        for (std::size_t index = begin; index < end; ++index) {
+            counts[index] = impossible;
+            int squares[max_tablebase_pieces];
+            player toMove = squaresOf(index, squares);
+            char placement[64] {};
+            bool valid = true;
+            for (int i = 0; i < t.size; ++i) {
+                char letter = piece_letters[static_cast<int>(t.types[i])];
+                bool lastRank = squares[i] < 8 || squares[i] >= 56;
+                valid = valid && !placement[squares[i]] && !(t.types[i] == piece_type::pawn && lastRank);
+                placement[squares[i]] = t.owners[i] == player::white ? letter : static_cast<char>(letter + 32);
+            }
+            if (!valid) {
+                continue;
+            }
+            char fen[chess::max_fen_length];
+            int length = 0;
+            for (int rank = 7; rank >= 0; --rank) {
+                for (int file = 0; file < 8; ++file) {
+                    char letter = placement[8 * rank + file];
+                    if (letter) {
+                        fen[length++] = letter;
+                    } else if (length > 0 && fen[length - 1] >= '1' && fen[length - 1] <= '7') {
+                        ++fen[length - 1];
+                    } else {
+                        fen[length++] = '1';
+                    }
+                }
+                fen[length++] = rank > 0 ? '/' : ' ';
+            }
+            std::memcpy(fen + length, toMove == player::white ? "w - -" : "b - -", 5);
+            length += 5;
+            if (!board.fromFEN(std::string_view(fen, length)) ||
+                board.isAttacked(board.kingPosition(other(toMove)), toMove)) {
+                continue;
+            }
+
+            ply_list list;
+            board.generateLegalMoves(list);
+            if (list.size == 0 && board.isChecked()) {
+                found[thread].push_back({0, static_cast<std::uint32_t>(index)});
+            }
+            int count = 0;
+            tb_result best;
+            bool leaves = false;
+            for (ply p: list) {
+                if (!board.isCapture(p) && p.promote == piece_type::pawn) {
+                    ++count;
+                    continue;
+                }
+                undo_record record;
+                board.makeMove(p, record);
+                tb_result child;
+                if (!probe(board, child)) {
+                    missing = true;
+                }
+                board.unmakeMove(record);
+                tb_result r;
+                r.plies = child.outcome == tb_outcome::draw ? 0 : child.plies + 1;
+                r.outcome = child.outcome == tb_outcome::win ? tb_outcome::loss
+                          : child.outcome == tb_outcome::loss ? tb_outcome::win : tb_outcome::draw;
+                if (!leaves || rank(r) > rank(best)) {
+                    best = r;
+                }
+                leaves = true;
+            }
+            counts[index] = static_cast<std::uint8_t>(count);
+            if (!leaves) {
+                continue;
+            }
+            exits[index] = 1 + encode(best.outcome, best.plies);
+            if (best.outcome == tb_outcome::win || (best.outcome == tb_outcome::loss && count == 0)) {
+                found[thread].push_back({static_cast<std::uint8_t>(best.plies), static_cast<std::uint32_t>(index)});
+            }
+        }
+    });
+    if (missing) {
+        return false;
+    }
+
+    /* Retrograde analysis, one depth after another. A position lost in ‹depth› plies
+     * makes every position that moves into it won in one more; a won one takes a move
+     * away from each of them, and a position left without a move that does not lose
+     * is lost. */
+    std::vector<std::uint32_t> frontier;
+    for (int depth = 0; depth < 255; ++depth) {
+        for (auto& thread: found) {
+            for (auto [at, index]: thread) {
+                pending[at].push_back(index);
+            }
+            thread.clear();
+        }
+        // Only the first of the positions found for a depth counts.
+        tb_outcome outcome = depth % 2 ? tb_outcome::win : tb_outcome::loss;
+        for (std::uint32_t index: pending[depth]) {
+            std::uint8_t expected = 0;
+            if (values[index].compare_exchange_strong(expected, encode(outcome, depth))) {
+                frontier.push_back(index);
+            }
+        }
+        pending[depth].clear();
+        bool later = std::any_of(pending.begin() + depth + 1, pending.end(), [](const auto& p) { return !p.empty(); });
+        if (frontier.empty() && !later) {
+            break;
+        }
+        parallelFor(threads, frontier.size(), [&](std::size_t begin, std::size_t end, int thread) {
+            for (std::size_t f = begin; f < end; ++f) {
+                int squares[max_tablebase_pieces];
+                player toMove = squaresOf(frontier[f], squares);
+                player mover = other(toMove);
+                bitboard occupied = 0;
+                for (int i = 0; i < t.size; ++i) {
+                    occupied |= squareBit(squares[i]);
+                }
+                for (int i = 0; i < t.size; ++i) {
+                    if (t.owners[i] != mover) {
+                        continue;
+                    }
+                    // Squares the piece may have come from without capturing.
+                    bitboard origins = 0;
+                    if (t.types[i] == piece_type::pawn) {
+                        int back = mover == player::white ? -8 : 8;
+                        int rank = squares[i] / 8;
+                        bool single = mover == player::white ? rank >= 2 : rank <= 5;
+                        bool twoSteps = mover == player::white ? rank == 3 : rank == 4;
+                        if (single && !(occupied & squareBit(squares[i] + back))) {
+                            origins = squareBit(squares[i] + back);
+                            if (twoSteps && !(occupied & squareBit(squares[i] + 2 * back))) {
+                                origins |= squareBit(squares[i] + 2 * back);
+                            }
+                        }
+                    } else {
+                        origins = pieceAttacks(t.types[i], mover, squares[i], occupied) & ~occupied;
+                    }
+                    while (origins) {
+                        int previous[max_tablebase_pieces];
+                        std::copy(squares, squares + t.size, previous);
+                        previous[i] = popSquare(origins);
+                        std::uint32_t index = mover == player::white ? 0 : 1;
+                        for (int j = 0; j < t.size; ++j) {
+                            index = index << 6 | previous[j];
+                        }
+                        if (counts[index] == impossible || values[index] != 0) {
+                            continue;
+                        }
+                        if (outcome == tb_outcome::loss) {
+                            found[thread].push_back({static_cast<std::uint8_t>(depth + 1), index});
+                        } else if (counts[index].fetch_sub(1) == 1) {
+                            tb_result exit = decode(exits[index] - 1);
+                            if (exits[index] && exit.outcome != tb_outcome::loss) {
+                                continue;
+                            }
+                            int at = exits[index] ? std::max(depth + 1, exit.plies) : depth + 1;
+                            found[thread].push_back({static_cast<std::uint8_t>(at), index});
+                        }
+                    }
+                }
+            }
+        });
+        frontier.clear();
+    }
+    // Positions that cannot occur are never probed.
+    t.values.resize(positions);
+    for (std::size_t i = 0; i < positions; ++i) {
+        t.values[i] = counts[i] == impossible && i > 0 ? t.values[i - 1] : values[i].load();
+    }
+    return true;
+}
+
+bool tablebases::generate(std::string_view material, int threads) {
+    table t;
+    if (!parse(material, t)) {
+        return false;
+    }
+    if (find(t.material)) {
+        return true;
+    }
+    // First the materials left after a capture or a promotion.
+    for (std::size_t i = 1; i < t.material.size(); ++i) {
+        if (t.material[i] == 'K') {
+            continue;
+        }
+        std::string fewer = t.material;
+        fewer.erase(i, 1);
+        if (!generate(fewer, threads)) {
+            return false;
+        }
+        if (t.material[i] == 'P') {
+            for (char promote: {'Q', 'R', 'B', 'N'}) {
+                std::string promoted = t.material;
+                promoted[i] = promote;
+                if (!generate(promoted, threads)) {
+                    return false;
+                }
+            }
+        }
+    }
+    if (!build(t, std::max(1, threads))) {
+        return false;
+    }
+    _tables.push_back(std::move(t));
+    return true;
+}
+
+std::vector<std::string> tablebases::materials() const {
+    std::vector<std::string> names;
+    for (const table& t: _tables) {
+        names.push_back(t.material);
+    }
+    return names;
+}
+
+// The values as runs: the value and the length of the run, seven bits at a time.
+static std::vector<std::uint8_t> packRuns(const std::vector<std::uint8_t>& values) {
+    std::vector<std::uint8_t> runs;
+    for (std::size_t i = 0; i < values.size();) {
+        std::size_t end = i;
+        while (end < values.size() && values[end] == values[i]) {
+            ++end;
+        }
+        runs.push_back(values[i]);
+        for (std::size_t length = end - i; ; length >>= 7) {
+            runs.push_back(static_cast<std::uint8_t>((length & 127) | (length > 127 ? 128 : 0)));
+            if (length <= 127) {
+                break;
+            }
+        }
+        i = end;
+    }
+    return runs;
+}
+
+static bool unpackRuns(const std::vector<std::uint8_t>& runs, std::size_t positions, std::vector<std::uint8_t>& out) {
+    out.clear();
+    out.reserve(positions);
+    for (std::size_t i = 0; i < runs.size();) {
+        std::uint8_t value = runs[i++];
+        std::size_t length = 0;
+        int shift = 0;
+        bool more = true;
+        while (more && i < runs.size() && shift < 64) {
+            length |= std::size_t(runs[i] & 127) << shift;
+            more = runs[i++] & 128;
+            shift += 7;
+        }
+        if (more || length > positions - out.size()) {
+            return false;
+        }
+        out.insert(out.end(), length, value);
+    }
+    return out.size() == positions;
+}
+
+constexpr int max_code_length = 24;
+
+// Lengths of the Huffman codes of the bytes, zero for bytes that do not occur.
+static void codeLengths(const std::vector<std::uint8_t>& bytes, std::uint8_t lengths[256]) {
+    std::uint64_t counts[256] {};
+    for (std::uint8_t b: bytes) {
+        ++counts[b];
+    }
+    for (;;) {
+        // Nodes of the tree, the first 256 are the bytes.
+        std::vector<std::uint64_t> weight(counts, counts + 256);
+        std::vector<int> parent(256, -1);
+        std::vector<int> queue;
+        for (int b = 0; b < 256; ++b) {
+            if (counts[b]) {
+                queue.push_back(b);
+            }
+        }
+        auto heavier = [&](int a, int b) { return weight[a] > weight[b]; };
+        std::make_heap(queue.begin(), queue.end(), heavier);
+        while (queue.size() > 1) {
+            int nodes[2];
+            for (int& n: nodes) {
+                std::pop_heap(queue.begin(), queue.end(), heavier);
+                n = queue.back();
+                queue.pop_back();
+            }
+            weight.push_back(weight[nodes[0]] + weight[nodes[1]]);
+            parent.push_back(-1);
+            parent[nodes[0]] = parent[nodes[1]] = static_cast<int>(weight.size() - 1);
+            queue.push_back(static_cast<int>(weight.size() - 1));
+            std::push_heap(queue.begin(), queue.end(), heavier);
+        }
+        int longest = 0;
+        for (int b = 0; b < 256; ++b) {
+            int length = 0;
+            for (int n = b; parent[n] >= 0; n = parent[n]) {
+                ++length;
+            }
+            // A single byte still needs a bit.
+            lengths[b] = static_cast<std::uint8_t>(counts[b] ? std::max(length, 1) : 0);
+            longest = std::max(longest, length);
+        }
+        if (longest <= max_code_length) {
+            return;
+        }
+        // Flatter counts give shorter codes.
+        for (std::uint64_t& c: counts) {
+            c = c ? c / 2 + 1 : 0;
+        }
+    }
+}
+
+// Bytes ordered by the length of their code, and the first code and index of every length.
+struct canonical_code {
+    int symbols[256];
+    std::uint32_t first[max_code_length + 2];
+    int offset[max_code_length + 2];
+    int count[max_code_length + 2] {};
+
+    explicit canonical_code(const std::uint8_t lengths[256]) {
+        int n = 0;
+        for (int length = 1; length <= max_code_length; ++length) {
+            offset[length] = n;
+            for (int b = 0; b < 256; ++b) {
+                if (lengths[b] == length) {
+                    symbols[n++] = b;
+                    ++count[length];
+                }
+            }
+        }
+        std::uint32_t code = 0;
+        for (int length = 1; length <= max_code_length; ++length) {
+            first[length] = code;
+            code = (code + count[length]) << 1;
+        }
+    }
+};
+
+static std::vector<std::uint8_t> huffmanEncode(const std::vector<std::uint8_t>& bytes, const std::uint8_t lengths[256]) {
+    canonical_code canonical(lengths);
+    std::uint32_t codes[256] {};
+    for (int length = 1; length <= max_code_length; ++length) {
+        for (int i = 0; i < canonical.count[length]; ++i) {
+            codes[canonical.symbols[canonical.offset[length] + i]] = canonical.first[length] + i;
+        }
+    }
+    std::vector<std::uint8_t> out;
+    std::uint64_t buffer = 0;
+    int bits = 0;
+    for (std::uint8_t b: bytes) {
+        buffer = buffer << lengths[b] | codes[b];
+        bits += lengths[b];
+        while (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<std::uint8_t>(buffer >> bits));
+        }
+    }
+    if (bits > 0) {
+        out.push_back(static_cast<std::uint8_t>(buffer << (8 - bits)));
+    }
+    return out;
+}
+
+static bool huffmanDecode(const std::vector<std::uint8_t>& data, const std::uint8_t lengths[256], std::size_t count,
+                          std::vector<std::uint8_t>& out) {
+    canonical_code canonical(lengths);
+    out.clear();
+    out.reserve(count);
+    std::size_t bit = 0;
+    while (out.size() < count) {
+        std::uint32_t code = 0;
+        int length = 1;
+        for (; length <= max_code_length; ++length) {
+            if (bit >= 8 * data.size()) {
+                return false;
+            }
+            code = code << 1 | ((data[bit / 8] >> (7 - bit % 8)) & 1);
+            ++bit;
+            if (code - canonical.first[length] < static_cast<std::uint32_t>(canonical.count[length])) {
+                break;
+            }
+        }
+        if (length > max_code_length) {
+            return false;
+        }
+        out.push_back(static_cast<std::uint8_t>(canonical.symbols[canonical.offset[length] + code - canonical.first[length]]));
+    }
+    return true;
+}
+
+bool tablebases::save(std::string_view material, const char* path) const {
+    const table* t = find(material);
+    if (!t) {
+        return false;
+    }
+    std::FILE* file = std::fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    std::vector<std::uint8_t> runs = packRuns(t->values);
+    tablebase_header header;
+    std::memcpy(header.material, t->material.data(), t->material.size());
+    header.positions = t->values.size();
+    header.runBytes = runs.size();
+    std::uint8_t lengths[256];
+    codeLengths(runs, lengths);
+    std::vector<std::uint8_t> coded = huffmanEncode(runs, lengths);
+    bool good = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                std::fwrite(lengths, sizeof(lengths), 1, file) == 1 &&
+                std::fwrite(coded.data(), 1, coded.size(), file) == coded.size();
+    return std::fclose(file) == 0 && good;
+}
+
+bool tablebases::load(const char* path) {
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    tablebase_header header;
+    tablebase_header expected;
+    std::uint8_t lengths[256];
+    table t;
+    bool good = std::fread(&header, sizeof(header), 1, file) == 1 &&
+                std::memcmp(header.magic, expected.magic, sizeof(expected.magic)) == 0 &&
+                header.version == expected.version && header.material[sizeof(header.material) - 1] == '\0' &&
+                parse(header.material, t) && t.material == header.material &&
+                header.positions == std::size_t(2) << (6 * t.size) &&
+                std::fread(lengths, sizeof(lengths), 1, file) == 1;
+    std::vector<std::uint8_t> coded;
+    for (int c = good ? std::fgetc(file) : EOF; c != EOF; c = std::fgetc(file)) {
+        coded.push_back(static_cast<std::uint8_t>(c));
+    }
+    std::fclose(file);
+    std::vector<std::uint8_t> runs;
+    good = good && std::all_of(lengths, lengths + 256, [](std::uint8_t l) { return l <= max_code_length; }) &&
+           huffmanDecode(coded, lengths, header.runBytes, runs) && unpackRuns(runs, header.positions, t.values);
+    if (!good) {
+        return false;
+    }
+    for (table& held: _tables) {
+        if (held.material == t.material) {
+            held = std::move(t);
+            return true;
+        }
+    }
+    _tables.push_back(std::move(t));
+    return true;
+}
+
+bool tablebases::probe(const chess& board, tb_result& out) const {
+    bitboard occupied = board.pieces(player::white) | board.pieces(player::black);
+    if (std::popcount(occupied) > max_tablebase_pieces || board.castlingRights() ||
+        board.enPassantTarget() != position()) {
+        return false;
+    }
+    std::uint64_t key = 0;
+    for (player owner: {player::white, player::black}) {
+        for (int type = 0; type < 6; ++type) {
+            key += std::popcount(board.pieces(owner, static_cast<piece_type>(type))) *
+                   materialKey(owner, static_cast<piece_type>(type));
+        }
+    }
+    for (const table& t: _tables) {
+        bool swapped = t.key != key;
+        if (swapped && t.key != swapColours(key)) {
+            continue;
+        }
+        // With the colours swapped the board is looked at from the other side.
+        std::size_t index = (board.getPlayer() == player::white) != swapped ? 0 : 1;
+        bitboard left[2][6];
+        for (player owner: {player::white, player::black}) {
+            for (int type = 0; type < 6; ++type) {
+                left[static_cast<int>(owner)][type] = board.pieces(owner, static_cast<piece_type>(type));
+            }
+        }
+        for (int i = 0; i < t.size; ++i) {
+            player owner = swapped ? other(t.owners[i]) : t.owners[i];
+            int square = popSquare(left[static_cast<int>(owner)][static_cast<int>(t.types[i])]);
+            index = index << 6 | (swapped ? square ^ 56 : square);
+        }
+        out = decode(t.values[index]);
+        return true;
+    }
+    return false;
+}
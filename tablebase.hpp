@@ -0,0 +1,91 @@
+#pragma once
+
+#include "chess.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Endgame tablebases: the exact value of every position of a few pieces,
+ * generated by retrograde analysis.
+ *
+ * A material is written as the pieces of one side and then of the other, each
+ * starting with the king, e.g. "KQK", "KRKP" or "KBNK"; a table also covers the
+ * same material with the colours swapped. Every table stores one byte for each
+ * placement of its pieces and each player to move:
+ *
+ * ├┄┄┄┄┄┄┄┄┄┄┄┼┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┄┤
+ * │ 0         │ draw                                                        │
+ * │ 1 – 127   │ the player to move mates in that many moves                 │
+ * │ 128 + n   │ the player to move is mated in ‹n› moves, 128 is mate       │
+ *
+ * Positions with castling rights or an «en passant» capture are not covered,
+ * nor are materials with pawns on both sides, where that capture could arise.
+ *
+ * On disk the bytes of a table are packed into runs of the same value, each a
+ * value and a length, and the runs are Huffman coded: a file is a header, the
+ * lengths of the codes of the 256 byte values and the bits, first bit highest.
+ * Loading expands a table, so a probe is a few memory accesses. Positions that
+ * cannot occur take the value of the one before them, which makes the runs
+ * longer. */
+
+constexpr int max_tablebase_pieces = 4;
+
+enum class tb_outcome : std::uint8_t { draw, win, loss };
+
+// Value of a position for the player to move.
+struct tb_result {
+    tb_outcome outcome = tb_outcome::draw;
+    // Plies to the mate with best play on both sides, zero for a draw.
+    int plies = 0;
+};
+
+struct tablebase_header {
+    char magic[4] = {'C', 'G', 'T', 'B'};
+    std::uint32_t version = 1;
+    // Null-padded material of the table.
+    char material[8] = {};
+    std::uint64_t positions = 0;
+    // Length of the runs before the Huffman coding.
+    std::uint64_t runBytes = 0;
+};
+
+class tablebases {
+    struct table {
+        std::string material;
+        // Number of each piece of each player, see ‹materialKey›.
+        std::uint64_t key = 0;
+        int size = 0;
+        player owners[max_tablebase_pieces];
+        piece_type types[max_tablebase_pieces];
+        std::vector<std::uint8_t> values;
+    };
+
+    std::vector<table> _tables;
+
+    // Reads the material into ‹out›, with the side that has more first. Returns false for a
+    // material that is not supported.
+    static bool parse(std::string_view material, table& out);
+
+    const table* find(std::string_view material) const;
+
+    bool build(table& t, int threads) const;
+
+public:
+    /* Generates the table of ‹material› on ‹threads› threads, and before it the
+     * tables its captures and promotions lead to. Returns false if the material is
+     * not supported. Takes a few seconds for three pieces and minutes for four. */
+    bool generate(std::string_view material, int threads);
+
+    // Materials of the tables held, each as written by ‹generate›.
+    std::vector<std::string> materials() const;
+
+    // Writes the table of ‹material›, returns false if there is none or the file cannot be written.
+    bool save(std::string_view material, const char* path) const;
+
+    // Adds the table of the file, returns false if the file is not a valid table.
+    bool load(const char* path);
+
+    // Looks the position up, returns false if no table covers it.
+    bool probe(const chess& board, tb_result& out) const;
+};
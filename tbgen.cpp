@@ -0,0 +1,61 @@
+/* Tbgen: generates endgame tablebases.
+ *
+ *   tbgen [-t threads] [-d directory] material ...
+ *
+ * Generates the tables of the given materials (e.g. KQK, KRKP, KBNK) and of
+ * every material they lead to, and writes each into "directory/material.tb",
+ * the current directory by default. Prints the time taken and the size of every
+ * file. */
+
+#include "tablebase.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+
+static int usage() {
+    std::cerr << "usage: tbgen [-t threads] [-d directory] material ...\n";
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string directory = ".";
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else {
+            return usage();
+        }
+    }
+    if (i == argc) {
+        return usage();
+    }
+    tablebases tables;
+    auto start = std::chrono::steady_clock::now();
+    for (; i < argc; ++i) {
+        if (!tables.generate(argv[i], threads)) {
+            std::cerr << "cannot generate " << argv[i] << '\n';
+            return 1;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "generated in " << elapsed.count() << " s on " << threads << " threads\n";
+    for (const std::string& material: tables.materials()) {
+        std::string path = directory + '/' + material + ".tb";
+        struct stat info;
+        if (!tables.save(material, path.c_str()) || stat(path.c_str(), &info) != 0) {
+            std::cerr << "cannot write " << path << '\n';
+            return 1;
+        }
+        std::cout << path << ": " << info.st_size << " bytes\n";
+    }
+    return 0;
+}
@@ -0,0 +1,1086 @@
+#include "analysis.hpp"
+#include "archive.hpp"
+#include "book.hpp"
+#include "chess.hpp"
+#include "eval.hpp"
+#include "gamehost.hpp"
+#include "movepick.hpp"
+#include "nnue.hpp"
+#include "pgn.hpp"
+#include "search.hpp"
+#include "stats.hpp"
+#include "tablebase.hpp"
+#include "transposition.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+
+/* ##### TESTS ############################################################################## */
+
+void test_enpassant() {
+    chess my_chess = chess();
+    my_chess.play({4, 2}, {4, 4});
+    my_chess.play({1, 7}, {1, 6});
+    my_chess.play({4, 4}, {4, 5});
+    my_chess.print();
+    assert (!my_chess.getOccupant({4, 5}).canBeLapsed);
+    my_chess.play({3, 7}, {3, 5});
+    my_chess.print();
+    assert (my_chess.getOccupant({3, 5}).canBeLapsed);
+    assert (my_chess.play({4, 5}, {3, 6}) == result::capture);
+    my_chess.print();
+}
+
+void test_castling() {
+    chess my_chess = chess();
+    // big white
+    my_chess.placeOccupant(occupant(),{2, 1});
+    my_chess.placeOccupant(occupant(),{3, 1});
+    my_chess.placeOccupant(occupant(),{4, 1});
+    my_chess.print();
+    my_chess.play({5, 1}, {3, 1});
+    my_chess.print();
+    // small black
+    my_chess.placeOccupant(occupant(),{6, 8});
+    my_chess.placeOccupant(occupant(),{7, 8});
+    my_chess.print();
+    my_chess.play({5, 8}, {7, 8});
+    my_chess.print();
+}
+
+void test_promote() {
+    chess my_chess = chess();
+    my_chess.play({2, 2},{2, 4});
+    my_chess.play({6, 7},{6, 5});
+    my_chess.play({2, 4},{2, 5});
+    my_chess.play({6, 5},{6, 4});
+    my_chess.print();
+    my_chess.play({3, 2},{3, 4});
+    my_chess.print();
+    my_chess.play({6, 4},{6, 3});
+    my_chess.print();
+    my_chess.play({3, 4},{3, 5});
+    my_chess.print();
+    my_chess.play({2, 7},{2, 6});
+    my_chess.print();
+    my_chess.play({3, 5},{2, 6});
+    my_chess.print();
+    my_chess.play({2, 8},{3, 6});
+    my_chess.print();
+    my_chess.play({2, 6},{1, 7});
+    my_chess.print();
+    my_chess.play({1, 8},{2, 8});
+    my_chess.print();
+    my_chess.play({1, 7},{2, 8}, piece_type::bishop);
+    my_chess.print();
+    my_chess.play({6, 3}, {5, 2});
+    my_chess.print();
+    assert( my_chess.play({2, 8}, {3, 7}) == result::capture);
+    my_chess.print();
+
+}
+
+void test_generate() {
+    ply_list list;
+    chess my_chess = chess();
+    my_chess.generateLegalMoves(list);
+    assert(list.size == 20);
+
+    // En passant.
+    my_chess.play({4, 2}, {4, 4});
+    my_chess.play({1, 7}, {1, 6});
+    my_chess.play({4, 4}, {4, 5});
+    my_chess.play({3, 7}, {3, 5});
+    my_chess.generateLegalMoves(list);
+    ply lapse {position{4, 5}, position{3, 6}};
+    assert(list.contains(lapse));
+
+    // Castling and promotion.
+    chess c = chess();
+    c.placeOccupant(occupant(), {2, 1});
+    c.placeOccupant(occupant(), {3, 1});
+    c.placeOccupant(occupant(), {4, 1});
+    c.placeOccupant(occupant(), {2, 8});
+    c.placeOccupant(occupant{player::white, piece_type::pawn}, {2, 7});
+    c.generateLegalMoves(list);
+    assert(list.contains({position{5, 1}, position{3, 1}}));
+    int promotions = 0;
+    for (ply p: list) {
+        if (p.promote != piece_type::pawn) {
+            ++promotions;
+            assert(c.validate(p.origin(), p.target(), false) == result::ok);
+        }
+    }
+    // b7 to a8 and c8 both capture, b8 is vacant.
+    assert(promotions == 12);
+}
+
+void test_perft() {
+    chess my_chess = chess();
+    assert(my_chess.perft(3) == 8902);
+    ply p;
+    assert(ply::fromString("e2e4", p) && p.toString() == "e2e4");
+    assert(ply::fromString("b7a8q", p) && p.promote == piece_type::queen && p.toString() == "b7a8q");
+    assert(!ply::fromString("e9e4", p));
+    my_chess.play({5, 2}, {5, 4});
+    assert(my_chess.perft(2) == 600);
+    assert(my_chess.key() != chess().key());
+}
+
+void test_attacks() {
+    chess my_chess = chess();
+    bitboard third = bitboard(0xff) << 16;
+    assert((my_chess.attacks(player::white) & third) == third);
+    assert(my_chess.isAttacked({5, 3}, player::white));
+    assert(!my_chess.isAttacked({5, 5}, player::white));
+    assert(my_chess.kingPosition(player::black) == position({5, 8}));
+    my_chess.play({6, 2}, {6, 3});
+    my_chess.play({5, 7}, {5, 5});
+    my_chess.play({7, 2}, {7, 4});
+    assert(!my_chess.isChecked());
+    my_chess.play({4, 8}, {8, 4});
+    assert(my_chess.isChecked());
+    assert(my_chess.isAttacked({5, 1}, player::black));
+    // Hand-made changes are seen before the next move.
+    my_chess.placeOccupant(occupant(), {8, 4});
+    assert(!my_chess.isChecked());
+    assert(!my_chess.isAttacked({5, 1}, player::black));
+}
+
+void test_undo() {
+    chess my_chess = chess();
+    move_history history;
+    assert(!my_chess.undo(history));
+    // En passant, castling and a promotion that captures.
+    position moves[][2] = {
+        {{5, 2}, {5, 4}}, {{1, 7}, {1, 6}}, {{5, 4}, {5, 5}}, {{4, 7}, {4, 5}}, {{5, 5}, {4, 6}},
+        {{7, 8}, {6, 6}}, {{4, 6}, {3, 7}}, {{5, 7}, {5, 6}}, {{7, 1}, {6, 3}}, {{6, 8}, {5, 7}},
+        {{6, 1}, {5, 2}}, {{5, 8}, {7, 8}}, {{3, 7}, {2, 8}}};
+    chess boards[std::size(moves)];
+    for (std::size_t i = 0; i < std::size(moves); ++i) {
+        boards[i] = my_chess;
+        result r = my_chess.play(moves[i][0], moves[i][1], piece_type::queen, history);
+        assert(r == result::ok || r == result::capture);
+    }
+    assert(my_chess.at({2, 8}).piece == piece_type::queen);
+    assert(my_chess.at({6, 8}).piece == piece_type::rook);
+    for (std::size_t i = std::size(moves); i-- > 0;) {
+        assert(my_chess.undo(history));
+        assert(my_chess.key() == boards[i].key());
+        for (int square = 0; square < 64; ++square) {
+            occupant o = my_chess.getOccupant(position::fromIndex(square));
+            occupant expected = boards[i].getOccupant(position::fromIndex(square));
+            assert(o.is_empty == expected.is_empty && o.owner == expected.owner && o.piece == expected.piece &&
+                   o.didMove == expected.didMove && o.didTwoStep == expected.didTwoStep &&
+                   o.canBeLapsed == expected.canBeLapsed);
+        }
+    }
+    assert(!my_chess.undo(history));
+    assert(my_chess.isAttacked({5, 3}, player::white));
+}
+
+void test_key() {
+    chess my_chess = chess();
+    std::uint64_t initial = my_chess.key();
+    assert(my_chess.castlingRights() == 15);
+    // Knights out and back give the same position.
+    my_chess.play({7, 1}, {6, 3});
+    my_chess.play({7, 8}, {6, 6});
+    my_chess.play({6, 3}, {7, 1});
+    assert(my_chess.key() != initial);
+    my_chess.play({6, 6}, {7, 8});
+    assert(my_chess.key() == initial);
+    // A two-step is an «en passant» position only if a pawn can take.
+    my_chess.play({5, 2}, {5, 4});
+    assert(my_chess.enPassantTarget() == position({5, 3}));
+    chess other = chess();
+    other.placeOccupant(occupant(), {5, 2});
+    other.placeOccupant(occupant{player::white, piece_type::pawn}, {5, 4});
+    other.swapPlayer();
+    assert(other.enPassantTarget() == position());
+    assert(my_chess.key() == other.key());
+    chess lapse = chess();
+    chess plain = chess();
+    position lapseMoves[][2] = {{{1, 2}, {1, 3}}, {{4, 7}, {4, 5}}, {{1, 3}, {1, 4}}, {{4, 5}, {4, 4}},
+                                {{5, 2}, {5, 4}}};
+    position plainMoves[][2] = {{{1, 2}, {1, 4}}, {{4, 7}, {4, 5}}, {{5, 2}, {5, 3}}, {{4, 5}, {4, 4}},
+                                {{5, 3}, {5, 4}}};
+    for (int i = 0; i < 5; ++i) {
+        lapse.play(lapseMoves[i][0], lapseMoves[i][1]);
+        plain.play(plainMoves[i][0], plainMoves[i][1]);
+    }
+    assert(lapse.key() != plain.key());
+    assert(lapse.play({4, 4}, {5, 3}) == result::capture);
+    // Moving the rook loses the right even when it comes back.
+    position rookMoves[][2] = {{{8, 7}, {8, 5}}, {{8, 2}, {8, 4}}, {{8, 8}, {8, 6}}, {{8, 1}, {8, 3}},
+                               {{8, 6}, {8, 8}}, {{8, 3}, {8, 1}}};
+    for (auto& m: rookMoves) {
+        assert(my_chess.play(m[0], m[1]) == result::ok);
+    }
+    assert(my_chess.castlingRights() == (chess::white_queen_side | chess::black_queen_side));
+
+    transposition_table table(1);
+    ply best {position{5, 2}, position{5, 4}};
+    tt_entry entry;
+    assert(!table.probe(initial, entry));
+    table.store(initial, best, 35, 6, bound::exact);
+    assert(table.probe(initial, entry) && entry.move == best && entry.score == 35 && entry.depth == 6);
+    table.store(initial, ply(), -20, 7, bound::upper);
+    assert(table.probe(initial, entry) && entry.move == best && entry.type == bound::upper);
+    table.clear();
+    assert(!table.probe(initial, entry));
+}
+
+// Board with only the given pieces, white to move.
+chess setup(std::initializer_list<std::pair<occupant, position>> pieces) {
+    chess board = chess();
+    for (int square = 0; square < 64; ++square) {
+        board.placeOccupant(occupant(), position::fromIndex(square));
+    }
+    for (auto& [o, at]: pieces) {
+        board.placeOccupant(o, at);
+    }
+    return board;
+}
+
+void test_search() {
+    occupant whiteKing {player::white, piece_type::king};
+    occupant blackKing {player::black, piece_type::king};
+    occupant blackPawn {player::black, piece_type::pawn};
+    engine e(1);
+    search_limits limits;
+    limits.depth = 4;
+
+    // Back rank mate.
+    chess mate = setup({{whiteKing, {7, 1}}, {occupant{player::white, piece_type::rook}, {1, 1}},
+                        {blackKing, {7, 8}}, {blackPawn, {6, 7}}, {blackPawn, {7, 7}}, {blackPawn, {8, 7}}});
+    search_result r = e.search(mate, limits);
+    assert(r.best == ply(position{1, 1}, position{1, 8}));
+    assert(r.score == mate_score - 1);
+
+    // Hanging queen.
+    chess hanging = setup({{whiteKing, {7, 1}}, {occupant{player::white, piece_type::rook}, {4, 1}},
+                           {blackKing, {7, 8}}, {occupant{player::black, piece_type::queen}, {4, 5}}});
+    r = e.search(hanging, limits);
+    assert(r.best == ply(position{4, 1}, position{4, 5}));
+    assert(r.score > 300 && r.pv.size() >= 1);
+
+    // Stalemate.
+    chess stalemate = setup({{blackKing, {1, 8}}, {occupant{player::white, piece_type::queen}, {2, 6}},
+                             {whiteKing, {3, 6}}});
+    stalemate.swapPlayer();
+    r = e.search(stalemate, limits);
+    assert(r.pv.empty() && r.score == 0);
+
+    // Node budget.
+    limits.depth = max_depth;
+    limits.nodes = 20000;
+    int iterations = 0;
+    r = e.search(chess(), limits, [&](const search_result&) { ++iterations; });
+    assert(r.depth >= 1 && r.depth == iterations && r.nodes < 40000);
+    chess board = chess();
+    assert(board.play(r.best.origin(), r.best.target()) == result::ok);
+
+    // Helper threads share the table and leave the result to the main thread.
+    e.clear();
+    e.setThreads(3);
+    limits.depth = 4;
+    limits.nodes = 0;
+    r = e.search(mate, limits);
+    assert(r.best == ply(position{1, 1}, position{1, 8}) && r.score == mate_score - 1);
+    r = e.search(chess(), limits);
+    assert(r.depth == 4);
+    board = chess();
+    assert(board.play(r.best.origin(), r.best.target()) == result::ok);
+
+    // A stop made before the search begins is kept until ‹prepare›.
+    e.stop();
+    r = e.search(chess(), limits);
+    assert(r.depth <= 1);
+    e.prepare();
+    r = e.search(chess(), limits);
+    assert(r.depth == 4);
+}
+
+void test_fen() {
+    const char* start = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    chess initial = chess();
+    chess board;
+    assert(board.fromFEN(start));
+    assert(board.key() == initial.key());
+    for (int square = 0; square < 64; ++square) {
+        occupant o = board.getOccupant(position::fromIndex(square));
+        occupant expected = initial.getOccupant(position::fromIndex(square));
+        assert(o.is_empty == expected.is_empty && o.owner == expected.owner && o.piece == expected.piece &&
+               o.didMove == expected.didMove && o.didTwoStep == expected.didTwoStep);
+    }
+
+    char text[chess::max_fen_length];
+    for (const char* fen: {start, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                           "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+                           "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w Kq f6 0 1",
+                           "4k3/8/8/8/3p4/8/8/4K2R b K - 0 1"}) {
+        assert(board.fromFEN(fen));
+        assert(board.toFEN(text) == int(std::string_view(fen).size()) && std::string_view(text) == fen);
+    }
+    assert(board.fromFEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -"));
+    assert(board.perft(2) == 2039);
+
+    // Castling rights and the «en passant» target end up in the occupant flags.
+    assert(board.fromFEN("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w Kq f6 0 1"));
+    assert(board.castlingRights() == (chess::white_king_side | chess::black_queen_side));
+    assert(board.at({1, 1}).didMove && !board.at({8, 1}).didMove && !board.at({5, 1}).didMove);
+    assert(board.at({6, 5}).canBeLapsed && board.at({6, 5}).didTwoStep && board.at({5, 5}).didMove);
+    assert(board.play({5, 5}, {6, 6}) == result::capture);
+    assert(board.fromFEN("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w Kq f6 0 1"));
+    // Only the last move is known, so d5 is not taken for a pawn that moved two squares.
+    assert(board.play({5, 5}, {4, 6}) == result::bad_move);
+    assert(board.play({5, 1}, {7, 1}) == result::blocked);
+
+    // Invalid texts leave the board alone.
+    std::uint64_t key = board.key();
+    for (const char* fen: {"", "8/8/8/8/8/8/8/8 w - - 0 1", "rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+                           "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq - 0 1",
+                           "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkx - 0 1",
+                           "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e3 0 1",
+                           "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 x",
+                           "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBN w KQkq - 0 1"}) {
+        assert(!board.fromFEN(fen));
+        assert(board.key() == key);
+    }
+}
+
+void test_pgn() {
+    chess board = chess();
+    ply p;
+    assert(parseSan(board, "Nf3", p) == result::ok && p == ply(position{7, 1}, position{6, 3}));
+    assert(parseSan(board, "e4!?", p) == result::ok && p == ply(position{5, 2}, position{5, 4}));
+    assert(parseSan(board, "e5", p) == result::bad_move);
+    assert(parseSan(board, "Qd3", p) == result::blocked);
+    assert(parseSan(board, "Kf2", p) == result::blocked);
+    assert(parseSan(board, "O-O", p) == result::blocked);
+    assert(parseSan(board, "Zz9", p) == result::bad_move);
+
+    // Both knights reach d2, a pinned one does not count.
+    assert(board.fromFEN("4k3/8/8/8/4b3/5N2/6K1/1N6 w - - 0 1"));
+    assert(parseSan(board, "Nd2", p) == result::ok && p == ply(position{2, 1}, position{4, 2}));
+    assert(board.fromFEN("4k3/8/8/8/8/5N2/6K1/1N6 w - - 0 1"));
+    assert(parseSan(board, "Nd2", p) == result::bad_move);
+    assert(parseSan(board, "Nbd2", p) == result::ok && p == ply(position{2, 1}, position{4, 2}));
+    assert(parseSan(board, "N3d2", p) == result::ok && p == ply(position{6, 3}, position{4, 2}));
+    assert(parseSan(board, "Nf3xd2+", p) == result::ok && p == ply(position{6, 3}, position{4, 2}));
+    assert(board.fromFEN("4k3/P7/8/8/8/8/8/4K3 w - - 0 1"));
+    assert(parseSan(board, "a8=N", p) == result::ok && p.promote == piece_type::knight);
+    assert(parseSan(board, "a8Q", p) == result::ok && p.promote == piece_type::queen);
+    assert(parseSan(board, "a8=K", p) == result::bad_move);
+
+    game_report report = replayGame("[Event \"?\"]\n[Result \"1-0\"]\n\n"
+                                    "1. e4 {a (comment)} e5 2.Nf3 (2. f4 exf4 (2... d5)) Nc6 $1 3. Bb5 a6\n"
+                                    "4. Ba4 Nf6 5. O-O Be7 ; a comment until the end of the line\n"
+                                    "6. Re1 b5 7. Bb3 O-O 1-0 8. Qh5", 7);
+    assert(report.number == 7 && report.outcome == result::ok && report.plies == 14);
+    report = replayGame("[FEN \"4k3/P7/8/8/8/8/8/4K3 w - - 0 1\"]\n1. a8=Q+ Kd7 2. Qb7+ Ke6 3. Qb3+ Kd6 4. Ke2 Kc5 *");
+    assert(report.outcome == result::ok && report.plies == 8);
+    report = replayGame("1. e4 e5 2. Ke3 Nc6");
+    assert(report.outcome == result::bad_move && report.plies == 2 && report.move == "Ke3");
+    report = replayGame("[FEN \"8/8/8/8/8/8/8/8 w - - 0 1\"] 1. e4");
+    assert(report.outcome == result::bad_move && report.plies == 0);
+
+    // Enough games for several chunks, with a bad one in the middle.
+    std::FILE* file = std::tmpfile();
+    std::string padding(1000, 'x');
+    for (int game = 1; game <= 3000; ++game) {
+        std::fprintf(file, "[Event \"%d\"]\n[Site \"?\"]\n\n1. d4 d5 2. c4 %s {%s} *\n\n", game,
+                     game == 2345 ? "Kd5" : "e6", padding.c_str());
+    }
+    std::rewind(file);
+    std::vector<std::uint64_t> failed;
+    replay_stats stats = replayPgn(file, 2, [&](const game_report& r) { failed.push_back(r.number); });
+    std::fclose(file);
+    assert(stats.games == 3000 && stats.failed == 1 && stats.plies == 3000 * 4 - 1);
+    assert(failed.size() == 1 && failed[0] == 2345);
+}
+
+void test_archive() {
+    const char* path = "test_archive.tmp";
+    game_record games[3];
+    assert(replayGame("1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 4. Bxc6 dxc6 5. O-O f6 1-0", 1, &games[0]).outcome == result::ok);
+    assert(replayGame("[FEN \"4k3/P7/8/8/8/8/8/4K3 w - - 0 1\"] 1. a8=N Kd7 1/2-1/2", 2, &games[1]).outcome == result::ok);
+    assert(games[0].outcome == game_outcome::white_wins && games[0].moves.size() == 10);
+    assert(games[1].outcome == game_outcome::draw && games[1].moves[0].promote == piece_type::knight);
+
+    archive_writer writer;
+    assert(writer.open(path));
+    assert(writer.add(games[0]) && writer.add(games[1]) && writer.add(games[2]));
+    game_record illegal = games[0];
+    illegal.moves[1] = ply(position{5, 7}, position{5, 4});
+    assert(!writer.add(illegal));
+    assert(writer.close());
+
+    archive_reader reader;
+    assert(reader.open(path));
+    assert(reader.size() == 3 && reader.plies() == 12);
+    for (int n = 2; n >= 0; --n) {
+        archive_game game = reader.game(n);
+        assert(game.outcome == games[n].outcome && game.plies() == games[n].moves.size());
+        assert(game.fen.empty() == (n != 1));
+        game_cursor cursor;
+        assert(cursor.reset(game));
+        chess board = games[n].start;
+        ply p;
+        for (ply expected: games[n].moves) {
+            assert(cursor.board().key() == board.key());
+            assert(cursor.advance(p) && p == expected);
+            board.makeMove(expected);
+        }
+        assert(!cursor.advance(p) && cursor.board().key() == board.key());
+    }
+    reader.close();
+
+    // Archives of another version are not read.
+    std::FILE* file = std::fopen(path, "r+b");
+    std::uint32_t version = 1;
+    assert(file && std::fseek(file, 4, SEEK_SET) == 0 && std::fwrite(&version, sizeof(version), 1, file) == 1);
+    std::fclose(file);
+    assert(!reader.open(path));
+    std::remove(path);
+    assert(!reader.open(path));
+}
+
+void test_eval() {
+    // The piece-square sums kept by the moves agree with the ones of the same position set up afresh.
+    auto sumsAgree = [](const chess& board) {
+        char text[chess::max_fen_length];
+        board.toFEN(text);
+        chess fresh;
+        assert(fresh.fromFEN(text));
+        return fresh.middlegameScore() == board.middlegameScore() && fresh.endgameScore() == board.endgameScore();
+    };
+    chess initial;
+    assert(initial.middlegameScore() == 0 && initial.endgameScore() == 0 && evaluate(initial) == 0);
+
+    // Mirrored positions evaluate the same for the player to move.
+    chess board;
+    chess mirrored;
+    assert(board.fromFEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"));
+    assert(mirrored.fromFEN("r3k2r/pppbbppp/2n2q1P/1P2p3/3pn3/BN2PNP1/P1PPQPB1/R3K2R b KQkq - 0 1"));
+    assert(evaluate(board) == evaluate(mirrored) && evaluate(board) != 0);
+
+    const char* path = "test_network.tmp";
+    std::FILE* file = std::fopen(path, "wb");
+    assert(file);
+    std::uint32_t hidden = nnue_hidden;
+    std::fwrite("NNUE", 4, 1, file);
+    std::fwrite(&hidden, sizeof(hidden), 1, file);
+    std::uint32_t seed = 12345;
+    for (int i = 0; i < (nnue_inputs + 3) * nnue_hidden + 1; ++i) {
+        seed = seed * 1664525 + 1013904223;
+        std::int16_t weight = static_cast<std::int16_t>((seed >> 16) % 128) - 64;
+        std::fwrite(&weight, sizeof(weight), 1, file);
+    }
+    std::fclose(file);
+    network net;
+    assert(!net.load("no such file") && !net.loaded());
+    assert(net.load(path) && net.loaded());
+
+    // Random games pass through castling, «en passant» and promotions.
+    nnue_accumulator incremental;
+    nnue_accumulator fresh;
+    for (const char* fen: {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                           "r3k2r/1P4P1/8/3pP3/8/8/6p1/R3K2R w KQkq d6 0 1"}) {
+        assert(board.fromFEN(fen));
+        net.refresh(board, incremental);
+        move_history history;
+        for (int i = 0; i < 120; ++i) {
+            ply_list list;
+            board.generateLegalMoves(list);
+            if (list.size == 0) {
+                break;
+            }
+            seed = seed * 1664525 + 1013904223;
+            nnue_accumulator before = incremental;
+            board.makeMove(list.moves[(seed >> 16) % list.size], history);
+            net.update(before, board, history.last(), incremental);
+            net.refresh(board, fresh);
+            assert(std::memcmp(&incremental, &fresh, sizeof(fresh)) == 0);
+            assert(sumsAgree(board));
+        }
+        board.makeNullMove(history);
+        net.update(fresh, board, history.last(), incremental);
+        assert(std::memcmp(&incremental, &fresh, sizeof(fresh)) == 0);
+        for (int i = 0; i < 50; ++i) {
+            board.unmakeMove(history);
+            assert(sumsAgree(board));
+        }
+    }
+    engine e(1);
+    assert(!e.loadNetwork("no such file") && e.loadNetwork(path));
+    std::remove(path);
+    search_limits limits;
+    limits.depth = 3;
+    // Random weights make the captures of a busy position a huge tree, the initial one has none.
+    board = chess();
+    search_result result = e.search(board, limits);
+    assert(result.depth == 3 && board.play(result.best.origin(), result.best.target()) == result::ok);
+}
+
+void test_movepick() {
+    chess board;
+    for (const char* fen: {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                           "r3k2r/1P4P1/8/3pP3/8/8/6p1/R3K2R w KQkq d6 0 1",
+                           "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"}) {
+        assert(board.fromFEN(fen));
+        ply_list all, noisy, quiet;
+        board.generateLegalMoves(all);
+        board.generateLegalMoves(noisy, move_filter::noisy);
+        board.generateLegalMoves(quiet, move_filter::quiet);
+        assert(noisy.size > 0 && noisy.size + quiet.size == all.size);
+        for (ply p: noisy) {
+            assert(all.contains(p) && (board.isCapture(p) || p.promote != piece_type::pawn));
+        }
+        for (ply p: quiet) {
+            assert(all.contains(p) && !board.isCapture(p) && p.promote == piece_type::pawn);
+        }
+
+        // Every legal move comes once, the hash move and the killers before the other quiet moves.
+        ply hashMove = quiet.moves[quiet.size - 1];
+        ply killers[2] = {quiet.moves[0], ply(position{1, 1}, position{8, 8})};
+        int history[64][64] {};
+        move_picker picker(board, hashMove, killers, history);
+        ply_list picked;
+        ply p;
+        while (picker.next(p)) {
+            assert(!picked.contains(p) && all.contains(p));
+            assert((picked.size == 0) == (picker.current() == move_picker::hash));
+            assert((picked.size == noisy.size + 1) == (picker.current() == move_picker::killers));
+            picked.push(p);
+        }
+        assert(picked.size == all.size && picked.moves[0] == hashMove && picked.moves[noisy.size + 1] == killers[0]);
+
+        // Captures come by the value of the victim, underpromotions last.
+        move_picker noisyPicker = move_picker::noisyOnly(board);
+        int previous = 1 << 30;
+        int count = 0;
+        while (noisyPicker.next(p)) {
+            occupant victim = board.at(p.target());
+            int value = victim.is_empty ? 0 : capture_values[static_cast<int>(victim.piece)];
+            if (p.promote == piece_type::queen) {
+                value += capture_values[static_cast<int>(piece_type::queen)];
+            } else if (p.promote != piece_type::pawn) {
+                value = -1;
+            }
+            assert(noisy.contains(p) && (value <= previous || (victim.is_empty && board.isCapture(p))));
+            previous = std::min(previous, value);
+            ++count;
+        }
+        assert(count == noisy.size && noisyPicker.current() == move_picker::done);
+    }
+    // A victim is taken by the least valuable attacker first, the king last.
+    assert(board.fromFEN("7k/5B2/8/3q4/2P1K3/2N5/8/3R4 w - - 0 1"));
+    move_picker queenTakers = move_picker::noisyOnly(board);
+    ply_list takers;
+    ply p;
+    while (queenTakers.next(p)) {
+        takers.push(p);
+    }
+    assert(takers.size == 5 && board.at(takers.moves[0].origin()).piece == piece_type::pawn);
+    assert(board.at(takers.moves[3].origin()).piece == piece_type::rook);
+    assert(board.at(takers.moves[4].origin()).piece == piece_type::king);
+
+    assert(board.fromFEN("r3k2r/1P4P1/8/3pP3/8/8/6p1/R3K2R w KQkq d6 0 1"));
+    assert(board.isLegal(ply(position{5, 5}, position{4, 6})));
+    assert(board.isLegal(ply(position{2, 7}, position{1, 8}, piece_type::knight)));
+    assert(!board.isLegal(ply(position{2, 7}, position{1, 8})));
+    assert(!board.isLegal(ply(position{5, 1}, position{5, 3})));
+    assert(!board.isLegal(ply()));
+}
+
+// The keys given with the definition of the Polyglot book format.
+void test_polyglot_key() {
+    static const struct {
+        const char* moves;
+        std::uint64_t key;
+    } games[] = {{"", 0x463b96181691fc9c},
+                 {"e2e4", 0x823c9b50fd114196},
+                 {"e2e4 d7d5", 0x0756b94461c50fb0},
+                 {"e2e4 d7d5 e4e5", 0x662fafb965db29d4},
+                 {"e2e4 d7d5 e4e5 f7f5", 0x22a48b5a8e47ff78},
+                 {"e2e4 d7d5 e4e5 f7f5 e1e2", 0x652a607ca3f242c1},
+                 {"e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00fdd303c946bdd9},
+                 {"a2a4 b7b5 h2h4 b5b4 c2c4", 0x3c8123ea7b067637},
+                 {"a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5c3f9b829b279560}};
+    for (const auto& game: games) {
+        chess board;
+        std::istringstream moves(game.moves);
+        std::string word;
+        while (moves >> word) {
+            ply p;
+            assert(ply::fromString(word, p) && board.isLegal(p));
+            board.makeMove(p);
+        }
+        assert(polyglotKey(board) == game.key);
+    }
+}
+
+void test_book() {
+    const char* path = "test_book.tmp";
+    book_builder builder;
+    chess board;
+    ply e4(position{5, 2}, position{5, 4});
+    ply d4(position{4, 2}, position{4, 4});
+    builder.add(board, e4, 2);
+    builder.add(board, d4, 1);
+    builder.add(board, e4, 1);
+    // Castling goes through the king-takes-rook form and back, promotions keep their piece.
+    chess castling;
+    assert(castling.fromFEN("r3k2r/1P6/8/8/8/8/8/R3K2R w KQkq - 0 1"));
+    ply kingSide(position{5, 1}, position{7, 1});
+    ply promote(position{2, 7}, position{1, 8}, piece_type::knight);
+    builder.add(castling, kingSide, 5);
+    builder.add(castling, promote, 0);
+    assert(builder.write(path));
+
+    opening_book book;
+    assert(book.open(path) && book.size() == 4);
+    std::vector<book_move> moves = book.probe(board);
+    assert(moves.size() == 2 && moves[0].move == e4 && moves[0].weight == 3 && moves[1].move == d4);
+    moves = book.probe(castling);
+    assert(moves.size() == 2 && moves[0].move == kingSide && moves[1].move == promote && moves[1].weight == 0);
+    ply p;
+    assert(book.pick(board, 0, p) && p == e4 && book.pick(board, 2, p) && p == e4 && book.pick(board, 7, p) && p == d4);
+    assert(book.pick(castling, 12345, p) && p == kingSide);
+    assert(board.play(e4.origin(), e4.target()) == result::ok);
+    assert(book.probe(board).empty() && !book.pick(board, 0, p));
+    book.close();
+    std::remove(path);
+    assert(!book.open(path));
+}
+
+void test_tablebase() {
+    const char* path = "test_tablebase.tmp";
+    tablebases tables;
+    assert(!tables.generate("KPKP", 2) && !tables.generate("KQRKR", 2) && !tables.generate("QKK", 2));
+    assert(tables.generate("KQK", 2));
+    std::vector<std::string> materials = tables.materials();
+    assert(std::find(materials.begin(), materials.end(), "KK") != materials.end());
+    assert(std::find(materials.begin(), materials.end(), "KQK") != materials.end());
+
+    chess board;
+    tb_result r;
+    // Mated, stalemated, and a queen that can be taken.
+    assert(board.fromFEN("k7/1Q6/1K6/8/8/8/8/8 b - - 0 1") && tables.probe(board, r));
+    assert(r.outcome == tb_outcome::loss && r.plies == 0);
+    assert(board.fromFEN("k7/2K5/1Q6/8/8/8/8/8 b - - 0 1") && tables.probe(board, r));
+    assert(r.outcome == tb_outcome::draw);
+    assert(board.fromFEN("k7/1Q6/8/8/8/8/8/7K b - - 0 1") && tables.probe(board, r));
+    assert(r.outcome == tb_outcome::draw);
+    // A win is found from either colour.
+    assert(board.fromFEN("8/8/8/3k4/8/8/8/KQ6 w - - 0 1") && tables.probe(board, r));
+    assert(r.outcome == tb_outcome::win && r.plies % 2 == 1 && r.plies <= 19);
+    tb_result swapped;
+    assert(board.fromFEN("kq6/8/8/8/3K4/8/8/8 b - - 0 1") && tables.probe(board, swapped));
+    assert(swapped.outcome == r.outcome && swapped.plies == r.plies);
+    // Castling rights and materials without a table are left to the search.
+    assert(board.fromFEN("4k3/8/8/8/8/8/8/R3K3 w Q - 0 1") && !tables.probe(board, r));
+    assert(board.fromFEN("4k3/8/8/8/8/8/8/R3K3 w - - 0 1") && !tables.probe(board, r));
+
+    assert(tables.save("KQK", path) && !tables.save("KRK", path));
+    tablebases loaded;
+    assert(loaded.load(path) && loaded.materials() == std::vector<std::string> {"KQK"});
+    for (const char* fen: {"k7/1Q6/1K6/8/8/8/8/8 b - - 0 1", "8/8/8/3k4/8/8/8/KQ6 w - - 0 1",
+                           "8/8/2k5/8/8/5Q2/8/7K b - - 0 1"}) {
+        tb_result expected;
+        assert(board.fromFEN(fen) && tables.probe(board, expected) && loaded.probe(board, r));
+        assert(r.outcome == expected.outcome && r.plies == expected.plies);
+    }
+    std::remove(path);
+    assert(!loaded.load(path));
+
+    // The search scores the position from the table.
+    engine e(1);
+    e.setTablebases(&tables);
+    search_limits limits;
+    limits.depth = 3;
+    assert(board.fromFEN("8/8/8/3k4/8/8/8/KQ6 w - - 0 1") && tables.probe(board, r));
+    search_result found = e.search(board, limits);
+    assert(found.score == mate_score - r.plies);
+}
+
+void test_stats() {
+    stats_snapshot before = chess::stats();
+    chess board;
+    assert(board.play({5, 2}, {5, 4}) == result::ok);
+    ply_list moves;
+    board.generateLegalMoves(moves);
+    engine e(1);
+    search_limits limits;
+    limits.depth = 3;
+    e.search(board, limits);
+    stats_snapshot done = chess::stats() - before;
+    if constexpr (stats_enabled) {
+        assert(done[counter::play] == 1 && done[counter::search] == 1);
+        assert(done[counter::generated_moves] >= 20 && done[counter::nodes] > 0 && done[counter::table_probes] > 0);
+        assert(done.nanoseconds[static_cast<int>(counter::search)] > 0);
+    } else {
+        for (int i = 0; i < counter_count; ++i) {
+            assert(done.counts[i] == 0 && done.nanoseconds[i] == 0);
+        }
+    }
+}
+
+void test_classify() {
+    chess board;
+    move_table table;
+    board.classifyMoves(table);
+    assert(table.at({5, 2}, {5, 4}) == result::ok && table.at({5, 7}, {5, 5}) == result::bad_piece);
+    assert(table.at({4, 4}, {4, 5}) == result::no_piece && table.at({1, 1}, {1, 3}) == result::blocked);
+    assert(std::popcount(table.targets[position{7, 1}.index()]) == 2);
+
+    // Every answer is the one of ‹validate› and of a trial move, through checks, pins, castling and
+    // an «en passant» that would uncover the king, and along some random games from each position.
+    std::uint64_t random = 0x2545f4914f6cdd1d;
+    for (const char* fen: {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                           "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+                           "8/8/8/8/k2Pp2Q/8/8/3K4 b - d3 0 1",
+                           "r3k2r/8/8/8/4r3/8/8/R3K2R w KQkq - 0 1",
+                           "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"}) {
+        assert(board.fromFEN(fen));
+        for (int plies = 0; plies < 40; ++plies) {
+            board.classifyMoves(table);
+            bool checked = board.isChecked();
+            ply_list moves;
+            board.generateLegalMoves(moves);
+            int legal = 0;
+            for (int from = 0; from < 64; ++from) {
+                for (int to = 0; to < 64; ++to) {
+                    position origin = position::fromIndex(from);
+                    position target = position::fromIndex(to);
+                    result r = table.results[from][to];
+                    assert(r == board.validate(origin, target, checked));
+                    // The checks and pins agree with playing the move out.
+                    if ((r == result::ok || r == result::in_check || r == result::would_check) &&
+                        !board.isCastling(origin, target, board.getPlayer())) {
+                        assert((r != result::ok) == board.wouldCheck(origin, target));
+                    }
+                    legal += (table.targets[from] >> to) & 1;
+                }
+            }
+            int promotions = 0;
+            for (ply p: moves) {
+                promotions += p.promote != piece_type::pawn;
+            }
+            assert(legal == moves.size - promotions * 3 / 4);
+            if (moves.size == 0) {
+                break;
+            }
+            random ^= random << 13;
+            random ^= random >> 7;
+            random ^= random << 17;
+            board.makeMove(moves.moves[random % moves.size]);
+        }
+    }
+    assert(board.fromFEN("8/8/8/8/k2Pp2Q/8/8/3K4 b - d3 0 1"));
+    board.classifyMoves(table);
+    assert(table.at({5, 4}, {4, 3}) == result::would_check && table.at({5, 4}, {5, 3}) == result::ok);
+}
+
+void test_status() {
+    chess board;
+    move_history history;
+    char text[chess::max_fen_length];
+    auto play = [&](std::initializer_list<const char*> moves) {
+        for (const char* text: moves) {
+            ply p;
+            assert(ply::fromString(text, p) && board.play(p.origin(), p.target(), p.promote, history) <= result::ok);
+        }
+    };
+    assert(board.status(history) == game_status::ongoing && board.hasLegalMove());
+    play({"e2e4", "g8f6", "g1f3"});
+    assert(board.halfmoveClock() == 2 && board.fullmoveNumber() == 2);
+    board.toFEN(text);
+    assert(std::string_view(text) == "rnbqkb1r/pppppppp/5n2/8/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 2 2");
+    board.makeNullMove(history);
+    board.unmakeMove(history);
+    assert(board.halfmoveClock() == 2 && board.fullmoveNumber() == 2);
+
+    // Knights going back and forth repeat the position twice, the third time is a draw.
+    play({"f6g8", "f3g1", "g8f6", "g1f3"});
+    assert(board.repetitions(history) == 1 && board.status(history) == game_status::ongoing);
+    play({"f6g8", "f3g1", "g8f6", "g1f3"});
+    assert(board.repetitions(history) == 2 && board.status(history) == game_status::repetition);
+    // The position before came up as often, the one before that only once earlier.
+    board.unmakeMove(history);
+    assert(board.repetitions(history) == 2);
+    board.unmakeMove(history);
+    board.unmakeMove(history);
+    assert(board.repetitions(history) == 1 && board.halfmoveClock() == 7);
+
+    // The kings lose their castling rights on the way, so the first return is not a repetition.
+    assert(board.fromFEN("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1"));
+    history.clear();
+    play({"e1f1", "e8f8", "f1e1", "f8e8"});
+    assert(board.repetitions(history) == 0);
+    play({"e1f1", "e8f8", "f1e1", "f8e8"});
+    assert(board.repetitions(history) == 1);
+
+    // The start could take «en passant», its return after the knights' trip cannot, so it is not
+    // the same position.
+    assert(board.fromFEN("rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 1"));
+    history.clear();
+    play({"g1f3", "g8f6", "f3g1", "f6g8"});
+    assert(board.repetitions(history) == 0);
+    play({"g1f3", "g8f6", "f3g1", "f6g8"});
+    assert(board.repetitions(history) == 1 && board.status(history) == game_status::ongoing);
+
+    // Kings without castling rights keep the earlier positions in reach on their first moves.
+    assert(board.fromFEN("r3k3/8/8/8/8/8/8/R3K3 w Qq - 0 1"));
+    history.clear();
+    play({"a1a8", "e8d7", "e1d2", "d7e7", "d2e1", "e7d7"});
+    assert(board.repetitions(history) == 1);
+
+    assert(board.fromFEN("4k3/8/8/8/8/8/8/R3K3 w - - 99 80"));
+    history.clear();
+    assert(board.status(history) == game_status::ongoing);
+    play({"a1a2"});
+    assert(board.status(history) == game_status::fifty_moves);
+    assert(board.toFEN(text) > 0 && std::string_view(text) == "4k3/8/8/8/8/8/R7/4K3 b - - 100 80");
+    play({"e8d8"});
+    assert(board.fullmoveNumber() == 81);
+
+    assert(board.fromFEN("k7/1Q6/1K6/8/8/8/8/8 b - - 0 1") && board.status(history) == game_status::checkmate);
+    assert(!board.hasLegalMove());
+    assert(board.fromFEN("k7/2K5/1Q6/8/8/8/8/8 b - - 0 1") && board.status(history) == game_status::stalemate);
+    assert(board.fromFEN("4k3/8/8/8/8/8/8/4KN2 w - - 0 1") && board.status(history) == game_status::insufficient_material);
+    assert(board.fromFEN("4k3/8/8/2b5/8/8/8/2B1K3 w - - 0 1") && board.isInsufficientMaterial());
+    assert(board.fromFEN("4k3/8/8/3b4/8/8/8/2B1K3 w - - 0 1") && !board.isInsufficientMaterial());
+    assert(board.fromFEN("4k3/8/8/8/8/8/8/1NN1K3 w - - 0 1") && board.status(history) == game_status::ongoing);
+}
+
+void test_analysis() {
+    std::mutex mutex;
+    std::vector<analysis_event> events;
+    analysis background([&](const analysis_event& event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(event);
+    }, 1);
+    auto finished = [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::count_if(events.begin(), events.end(),
+                             [](const analysis_event& e) { return e.type == analysis_event::kind::finished; });
+    };
+    chess board;
+    search_limits limits;
+    limits.depth = 3;
+
+    // Every iteration is reported before the result.
+    std::uint64_t first = background.start(board, limits);
+    background.stop();
+    assert(!background.running() && finished() == 1);
+    background.start(board, limits);
+    while (background.running()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    assert(finished() == 2 && events.back().type == analysis_event::kind::finished);
+    assert(events.back().search == first + 1 && events.back().result.depth == 3);
+    assert(events[events.size() - 2].type == analysis_event::kind::iteration);
+
+    // An endless search is stopped at once, a new one ends the one before.
+    events.clear();
+    limits.depth = max_depth;
+    std::uint64_t endless = background.start(board, limits);
+    std::uint64_t next = background.start(board, limits);
+    assert(next == endless + 1 && finished() == 1 && events.back().search == endless);
+    auto begin = std::chrono::steady_clock::now();
+    background.stop();
+    assert(std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(100));
+    assert(finished() == 2 && events.back().search == next);
+
+    // A pondering search holds back its result past its limits until the ponder hit.
+    events.clear();
+    limits.depth = 2;
+    limits.time = std::chrono::milliseconds(1);
+    background.start(board, limits, true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(background.running() && finished() == 0);
+    background.ponderhit();
+    while (background.running()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    assert(finished() == 1 && events.back().result.best != ply());
+
+    // So does an infinite search until it is stopped, even when it ran out of depth.
+    events.clear();
+    limits.infinite = true;
+    background.start(board, limits);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(background.running() && finished() == 0);
+    background.ponderhit();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    assert(background.running() && finished() == 0);
+    background.stop();
+    assert(!background.running() && finished() == 1 && events.back().result.depth == 2);
+}
+
+void test_game_host() {
+    std::mutex mutex;
+    std::vector<game_reply> replies;
+    std::vector<std::string> fens;
+    // Fails if the replies do not come within a few seconds.
+    auto wait = [&](std::size_t count) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (replies.size() >= count) {
+                    return;
+                }
+            }
+            assert(std::chrono::steady_clock::now() < deadline);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    };
+    game_host host(2, 2, [&](const std::vector<game_reply>& batch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const game_reply& reply: batch) {
+            replies.push_back(reply);
+            char fen[chess::max_fen_length] = "";
+            if (reply.board) {
+                reply.board->toFEN(fen);
+            }
+            fens.push_back(fen);
+        }
+    });
+    create_error error;
+    assert(host.create("not a fen", error) == no_game && error == create_error::bad_fen);
+    game_id mated = host.create();
+    game_id other = host.create("4k3/8/8/8/8/8/8/R3K3 w - - 0 1", error);
+    assert(mated != no_game && other != no_game && mated != other && error == create_error::none);
+    assert(host.create("4k3/8/8/8/8/8/8/4K3 w - - 0 1", error) == no_game && error == create_error::full);
+
+    auto move = [](game_id game, const char* text) {
+        game_request request;
+        request.game = game;
+        assert(ply::fromString(text, request.move));
+        return request;
+    };
+    std::vector<game_request> requests;
+    for (const char* text: {"f2f3", "e7e5", "g2g4", "d8h4"}) {
+        requests.push_back(move(mated, text));
+    }
+    requests.push_back(move(other, "a1a8"));
+    requests.push_back(move(other, "a1b2"));
+    requests.push_back(move(12, "e2e4"));
+    game_request show;
+    show.type = game_request::kind::show;
+    show.game = other;
+    requests.push_back(show);
+    game_request end;
+    end.type = game_request::kind::end;
+    end.game = mated;
+    requests.push_back(end);
+    host.submit(requests);
+    wait(requests.size());
+
+    std::unique_lock<std::mutex> lock(mutex);
+    // The replies of one game come in order.
+    std::vector<game_reply> ofMated;
+    for (const game_reply& reply: replies) {
+        if (reply.request.game == mated) {
+            ofMated.push_back(reply);
+        }
+    }
+    assert(ofMated.size() == 5);
+    assert(ofMated[2].outcome == result::ok && ofMated[2].status == game_status::ongoing);
+    assert(ofMated[3].status == game_status::checkmate);
+    assert(ofMated[4].request.type == game_request::kind::end && ofMated[4].known);
+    for (std::size_t i = 0; i < replies.size(); ++i) {
+        const game_reply& reply = replies[i];
+        if (reply.request.game == 12) {
+            assert(!reply.known);
+        } else if (reply.request.game == other && reply.request.type == game_request::kind::show) {
+            assert(fens[i] == "R3k3/8/8/8/8/8/8/4K3 b - - 1 1");
+        } else if (reply.request.game == other) {
+            assert(reply.request.move.target() == position(1, 8) ? reply.outcome == result::ok
+                                                                   : reply.outcome > result::ok);
+        }
+    }
+
+    // The slot of the ended game is taken again under a new number, the old one is not played on.
+    replies.clear();
+    lock.unlock();
+    // The slot is freed once the callback has seen the end.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    game_id next;
+    while ((next = host.create()) == no_game) {
+        assert(std::chrono::steady_clock::now() < deadline);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    assert((next & 0xffffffff) == (mated & 0xffffffff) && next != mated);
+    host.submit({move(mated, "e2e4"), move(next, "e2e4")});
+    wait(2);
+    lock.lock();
+    for (const game_reply& reply: replies) {
+        assert(reply.known == (reply.request.game == next));
+    }
+}
+
+int main()
+{
+    chess my_chess = chess();
+    my_chess.print();
+    position a7 = {1, 7};
+    position a6 = {1, 6};
+    assert( my_chess.play( a7, a6 ) == result::bad_piece);
+    test_enpassant();
+    test_castling();
+    test_promote();
+    test_generate();
+    test_perft();
+    test_attacks();
+    test_undo();
+    test_key();
+    test_search();
+    test_fen();
+    test_pgn();
+    test_archive();
+    test_eval();
+    test_movepick();
+    test_polyglot_key();
+    test_book();
+    test_tablebase();
+    test_stats();
+    test_classify();
+    test_status();
+    test_analysis();
+    test_game_host();
+
+    chess c = chess();
+    assert(c.play( {1, 2}, {1, 4} ) == result::ok);
+    assert(c.play( {1, 7}, {1, 5} ) == result::ok);
+    assert(c.play( {1, 4}, {1, 5} ) == result::blocked);
+
+    assert(c.play( {7, 2}, {7, 3} ) == result::ok);
+    assert(c.play( {7, 7}, {7, 6} ) == result::ok);
+    assert(c.play( {6, 1}, {8, 3} ) == result::ok);
+    assert(c.play( {7, 8}, {6, 6} ) == result::ok);
+    assert(c.play( {7, 1}, {6, 3} ) == result::ok);
+    assert(c.play( {6, 8}, {8, 6} ) == result::ok);
+    c.print();
+    assert(c.play( {8, 1}, {7, 1} ) == result::ok);
+    c.print();
+    assert(c.play( {5, 7}, {5, 6} ) == result::ok);
+    c.print();
+    assert(c.play( {7, 1}, {8, 1} ) == result::ok);
+    c.print();
+    assert(c.play( {6, 6}, {8, 5} ) == result::ok);
+    c.print();
+    assert(c.play( {5, 1}, {7, 1} ) == result::has_moved);
+
+}
@@ -0,0 +1,110 @@
+#include "transposition.hpp"
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(tt_entry) == sizeof(std::uint64_t), "an entry has to be packed into one word");
+
+static std::uint64_t pack(const tt_entry& entry) {
+    std::uint64_t data;
+    std::memcpy(&data, &entry, sizeof(data));
+    return data;
+}
+
+static tt_entry unpack(std::uint64_t data) {
+    tt_entry entry;
+    std::memcpy(static_cast<void*>(&entry), &data, sizeof(data));
+    return entry;
+}
+
+transposition_table::transposition_table(std::size_t megabytes) {
+    resize(megabytes);
+}
+
+void transposition_table::resize(std::size_t megabytes) {
+    std::size_t count = 1;
+    while (count * 2 * sizeof(bucket) <= megabytes << 20) {
+        count *= 2;
+    }
+    if (count != _count) {
+        _buckets = std::make_unique<bucket[]>(count);
+        _count = count;
+    }
+    clear();
+}
+
+void transposition_table::clear() {
+    for (std::size_t i = 0; i < _count; ++i) {
+        for (slot& s: _buckets[i].slots) {
+            s.check.store(0, std::memory_order_relaxed);
+            s.data.store(0, std::memory_order_relaxed);
+        }
+    }
+    _age = 0;
+}
+
+bool transposition_table::probe(std::uint64_t key, tt_entry& entry) const {
+    for (const slot& s: bucketOf(key).slots) {
+        std::uint64_t data = s.data.load(std::memory_order_relaxed);
+        if ((s.check.load(std::memory_order_relaxed) ^ data) == key) {
+            entry = unpack(data);
+            if (entry.type != bound::none) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void transposition_table::store(std::uint64_t key, ply move, int score, int depth, bound type) {
+    // Entries of older searches lose 8 plies of depth for every search since.
+    auto worth = [this](const tt_entry& e) { return e.depth - 8 * std::uint8_t(_age - e.age); };
+    bucket& b = bucketOf(key);
+    slot* replace = nullptr;
+    int replaceWorth = 0;
+    // Entry of the same position that is going to be overwritten.
+    tt_entry previous;
+    for (slot& s: b.slots) {
+        std::uint64_t data = s.data.load(std::memory_order_relaxed);
+        tt_entry e = unpack(data);
+        if ((s.check.load(std::memory_order_relaxed) ^ data) == key) {
+            replace = &s;
+            previous = e;
+            break;
+        }
+        if (e.type == bound::none) {
+            replace = &s;
+            break;
+        }
+        if (!replace || worth(e) < replaceWorth) {
+            replace = &s;
+            replaceWorth = worth(e);
+        }
+    }
+    // Keep the best move of the position if the new result has none.
+    if (previous.type != bound::none && move == ply()) {
+        move = previous.move;
+    }
+    tt_entry entry;
+    entry.move = move;
+    entry.type = type;
+    entry.score = static_cast<std::int16_t>(score);
+    entry.depth = static_cast<std::int8_t>(depth);
+    entry.age = _age;
+    std::uint64_t data = pack(entry);
+    replace->data.store(data, std::memory_order_relaxed);
+    replace->check.store(key ^ data, std::memory_order_relaxed);
+}
+
+int transposition_table::hashfull() const {
+    std::size_t sample = std::min<std::size_t>(_count, 250);
+    int used = 0;
+    for (std::size_t i = 0; i < sample; ++i) {
+        for (const slot& s: _buckets[i].slots) {
+            tt_entry e = unpack(s.data.load(std::memory_order_relaxed));
+            if (e.type != bound::none && e.age == _age) {
+                ++used;
+            }
+        }
+    }
+    return static_cast<int>(used * 1000 / (sample * bucket_size));
+}
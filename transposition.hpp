@@ -0,0 +1,69 @@
+#pragma once
+
+#include "chess.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// How the stored score relates to the true score of the position.
+enum class bound : std::uint8_t { none, exact, lower, upper };
+
+struct tt_entry {
+    ply move;
+    bound type = bound::none;
+    std::int16_t score = 0;
+    std::int8_t depth = 0;
+    // Search generation the entry was written in, see ‹transposition_table::newSearch›.
+    std::uint8_t age = 0;
+};
+
+/* Fixed-size hash table of search results indexed by ‹chess::key›. Entries are
+ * grouped into buckets of one cache line, a position may be stored in any entry
+ * of its bucket and the least valuable entry is replaced (old searches first,
+ * then shallow depths).
+ *
+ * The table is shared by all search threads without locks. Every slot keeps the
+ * entry packed into one word and the key xor-ed with that word, so a slot torn
+ * by two threads writing at once no longer matches its key and is ignored. */
+class transposition_table {
+public:
+    static constexpr int bucket_size = 4;
+
+private:
+    struct slot {
+        std::atomic<std::uint64_t> check {0};
+        std::atomic<std::uint64_t> data {0};
+    };
+
+    struct alignas(64) bucket {
+        slot slots[bucket_size];
+    };
+
+    std::unique_ptr<bucket[]> _buckets;
+    std::size_t _count = 0;
+    std::uint8_t _age = 0;
+
+    bucket& bucketOf(std::uint64_t key) const { return _buckets[key & (_count - 1)]; }
+
+public:
+    explicit transposition_table(std::size_t megabytes = 16);
+
+    // Drops all entries and uses at most ‹megabytes› of memory (rounded down to a power of two
+    // of buckets, at least one bucket). Not safe while a search is running.
+    void resize(std::size_t megabytes);
+
+    void clear();
+
+    // Entries written from now on are preferred to the older ones on replacement.
+    void newSearch() { ++_age; }
+
+    // Copies the entry of the position into ‹entry› and returns true if there is one.
+    bool probe(std::uint64_t key, tt_entry& entry) const;
+
+    void store(std::uint64_t key, ply move, int score, int depth, bound type);
+
+    // Used entries written by the current search per mille, estimated from the first buckets.
+    int hashfull() const;
+
+    std::size_t size() const { return _count * bucket_size; }
+};
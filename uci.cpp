@@ -0,0 +1,240 @@
+/* Uci: the engine behind the Universal Chess Interface.
+ *
+ *   uci [-s seconds]
+ *
+ * Reads the commands of a GUI from the standard input and answers on the standard
+ * output. Supported are uci, isready, ucinewgame, setoption (Threads, Hash),
+ * position (startpos or fen, then moves), go (depth, nodes, movetime, wtime,
+ * btime, winc, binc, movestogo, infinite, ponder), ponderhit, stop and quit.
+ *
+ * A search runs in an ‹analysis› while this thread keeps reading, so «stop» and
+ * «isready» are answered at once. Each finished iteration is reported as «info»,
+ * the search ends with «bestmove», which after «go infinite» waits for «stop» and
+ * after «go ponder» for «ponderhit» or «stop». ‹-s› prints the counters of ‹stats.hpp› to the
+ * standard error every so many seconds, if they are compiled in. */
+
+#include "analysis.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Scores this close to ‹mate_score› are mates, including the long ones of the tablebases.
+constexpr int mate_range = 512;
+
+// Guesses of the number of moves left, and of the time lost between the GUI and the engine.
+constexpr int moves_to_go = 30;
+constexpr std::chrono::milliseconds move_overhead {30};
+
+static std::mutex output;
+
+// Lines are written whole, from the reader and from the search thread.
+static void say(const std::string& line) {
+    std::lock_guard<std::mutex> lock(output);
+    std::cout << line << std::endl;
+}
+
+static std::string scoreText(int score) {
+    if (std::abs(score) < mate_score - mate_range) {
+        return "cp " + std::to_string(score);
+    }
+    int plies = mate_score - std::abs(score);
+    return "mate " + std::to_string(score > 0 ? (plies + 1) / 2 : -(plies / 2));
+}
+
+static std::string infoText(const search_result& r) {
+    std::uint64_t nps = r.nodes * 1000 / std::max<std::int64_t>(1, r.time.count());
+    std::string text = "info depth " + std::to_string(r.depth) + " score " + scoreText(r.score) + " nodes " +
+                       std::to_string(r.nodes) + " time " + std::to_string(r.time.count()) + " nps " +
+                       std::to_string(nps) + " pv";
+    for (ply p: r.pv) {
+        text += ' ' + p.toString();
+    }
+    return text;
+}
+
+// Reads "startpos" or "fen ..." and then the moves, leaves ‹board› and ‹moves› alone if anything
+// is wrong.
+static bool setPosition(std::istringstream& command, chess& board, move_history& moves) {
+    chess next;
+    move_history played;
+    std::string word;
+    command >> word;
+    if (word == "fen") {
+        std::string fen;
+        while (command >> word && word != "moves") {
+            fen += (fen.empty() ? "" : " ") + word;
+        }
+        if (!next.fromFEN(fen)) {
+            return false;
+        }
+    } else if (word == "startpos") {
+        command >> word;
+    } else {
+        return false;
+    }
+    if (word == "moves") {
+        while (command >> word) {
+            ply p;
+            if (!ply::fromString(word, p) || !next.isLegal(p)) {
+                return false;
+            }
+            next.makeMove(p, played);
+        }
+    }
+    board = next;
+    moves = played;
+    return true;
+}
+
+// Reads the arguments of "go". A clock gives the move an equal share of the time left.
+static search_limits readLimits(std::istringstream& command, player mover, bool& ponder) {
+    search_limits limits;
+    std::string word;
+    long long clock[2] = {0, 0};
+    long long increment[2] = {0, 0};
+    long long movesToGo = moves_to_go;
+    bool timed = false;
+    ponder = false;
+    while (command >> word) {
+        long long value = 0;
+        if (word == "infinite") {
+            limits.infinite = true;
+            continue;
+        }
+        if (word == "ponder") {
+            ponder = true;
+            continue;
+        }
+        if (!(command >> value)) {
+            break;
+        }
+        if (word == "depth") {
+            limits.depth = std::clamp<long long>(value, 1, max_depth);
+        } else if (word == "nodes") {
+            limits.nodes = std::max(0LL, value);
+        } else if (word == "movetime") {
+            limits.time = std::chrono::milliseconds(std::max(1LL, value));
+        } else if (word == "wtime" || word == "btime") {
+            clock[word[0] == 'b'] = value;
+            timed = true;
+        } else if (word == "winc" || word == "binc") {
+            increment[word[0] == 'b'] = value;
+        } else if (word == "movestogo") {
+            movesToGo = std::max(1LL, value);
+        }
+    }
+    int side = mover == player::white ? 0 : 1;
+    if (timed && limits.time.count() == 0) {
+        std::chrono::milliseconds left {std::max(1LL, clock[side])};
+        std::chrono::milliseconds share {clock[side] / movesToGo + increment[side] / 2};
+        std::chrono::milliseconds most = std::max({left - move_overhead, left / 2, std::chrono::milliseconds(1)});
+        limits.time = std::clamp(share, std::chrono::milliseconds(1), most);
+    }
+    return limits;
+}
+
+static std::string bestMoveText(chess board, const search_result& r) {
+    ply best = r.best;
+    // Stopped before the first iteration finished.
+    if (r.pv.empty()) {
+        ply_list moves;
+        board.generateLegalMoves(moves);
+        if (moves.size == 0) {
+            return "bestmove 0000";
+        }
+        best = moves.moves[0];
+    }
+    std::string text = "bestmove " + best.toString();
+    if (r.pv.size() >= 2) {
+        text += " ponder " + r.pv[1].toString();
+    }
+    return text;
+}
+
+static int usage() {
+    std::cerr << "usage: uci [-s seconds]\n";
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    int statsSeconds = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            statsSeconds = std::max(1, std::atoi(argv[++i]));
+        } else {
+            return usage();
+        }
+    }
+    std::unique_ptr<stats_reporter> reporter;
+    if (statsSeconds) {
+        reporter = std::make_unique<stats_reporter>(std::cerr, std::chrono::seconds(statsSeconds));
+    }
+    std::ios::sync_with_stdio(false);
+    chess board;
+    move_history moves;
+    // Position of the last search, only changed while no search runs.
+    chess searched;
+    analysis background([&searched](const analysis_event& event) {
+        if (event.type == analysis_event::kind::iteration) {
+            say(infoText(event.result));
+        } else {
+            say(bestMoveText(searched, event.result));
+        }
+    });
+    engine& e = background.searcher();
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream command(line);
+        std::string word;
+        command >> word;
+        if (word == "uci") {
+            say("id name chess");
+            say("id author PinkieORG");
+            say("option name Threads type spin default 1 min 1 max 256");
+            say("option name Hash type spin default 16 min 1 max 65536");
+            say("option name Ponder type check default false");
+            say("uciok");
+        } else if (word == "isready") {
+            say("readyok");
+        } else if (word == "ucinewgame") {
+            background.stop();
+            e.clear();
+        } else if (word == "setoption") {
+            background.stop();
+            std::string name;
+            std::string value;
+            command >> word >> name >> word >> value;
+            if (name == "Threads") {
+                e.setThreads(std::clamp(std::atoi(value.c_str()), 1, 256));
+            } else if (name == "Hash") {
+                e.table().resize(std::clamp(std::atoi(value.c_str()), 1, 65536));
+            }
+        } else if (word == "position") {
+            background.stop();
+            if (!setPosition(command, board, moves)) {
+                say("info string bad position: " + line);
+            }
+        } else if (word == "go") {
+            background.stop();
+            bool ponder;
+            search_limits limits = readLimits(command, board.getPlayer(), ponder);
+            searched = board;
+            background.start(board, moves, limits, ponder);
+        } else if (word == "ponderhit") {
+            background.ponderhit();
+        } else if (word == "stop") {
+            background.stop();
+        } else if (word == "quit") {
+            break;
+        }
+    }
+    background.stop();
+    return 0;
+}